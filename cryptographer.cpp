@@ -314,6 +314,28 @@ void Cryptographer::setReplaceTable(uint8 **_replace_table)
 
 //==========================================================================//
 
+/*! Копирует значение ключа в \e _key.
+	\param _key - массив из 8 элементов для значения ключа.
+*/
+void Cryptographer::getKey(uint32 *_key) const
+{
+	memcpy(_key, m_key, sizeof(m_key));
+}
+
+//==========================================================================//
+
+/*! Копирует значения таблицы замен в таблицу \e _replace_table.
+	\param _replace_table - таблица размером 8 на 16 для значений таблицы замен.
+*/
+void Cryptographer::getReplaceTable(uint8 **_replace_table) const
+{
+	for(uint8 i = 0; i < 8; i++)
+		for(uint8 j = 0; j < 16; j++)
+			_replace_table[i][j] = m_replace_table[i][j];
+}
+
+//==========================================================================//
+
 /*! Копирует свойства объекта \e cr.
 	\param cr - объект класса \e Cryptographer.
 */
@@ -37,6 +37,8 @@ public:
 
 	void setKey(uint32 *_key);														//!< Установка ключа.
 	void setReplaceTable(uint8 **_replace_table);									//!< Установка таблицы замен.
+	void getKey(uint32 *_key) const;												//!< Получение ключа.
+	void getReplaceTable(uint8 **_replace_table) const;								//!< Получение таблицы замен.
 
 	Cryptographer &operator=(const Cryptographer &cr);								//!< Оператор присваивания.
 
@@ -0,0 +1,302 @@
+
+#ifndef _FIXEDPASSWORDGEN_H_
+#define _FIXEDPASSWORDGEN_H_
+
+#include <string.h>
+
+#include <string>
+
+#include "randomgen.h"
+
+/*! \file fixedpasswordgen.h
+	Генератор паролей \e FixedPasswordGen с алфавитом, заданным на этапе компиляции. Таблица номеров
+	символов, границы частот и статистики хи-квадрат для проверки последовательности и параметры
+	извлечения символов из случайных слов вычисляются компилятором. Для алфавитов, размер которых -
+	степень двойки (hex, base32, base64url), символы извлекаются из случайных слов сдвигами без
+	отбрасывания.
+	\par Пример:
+	\code
+	HexPasswordGen hex;
+	std::string token;
+	hex.nextPassword(token, 32);
+	char ids[1000 * 22];
+	Base64UrlPasswordGen b64;
+	b64.nextPasswords(ids, 1000, 22, 22);
+	\endcode
+	\par
+	Алфавит задаётся структурой со статическим constexpr-методом \e chars(), возвращающим
+	строку из 2-255 различных символов.
+*/
+
+//==========================================================================//
+
+//! Алфавит шестнадцатеричных цифр.
+struct HexAlphabet
+{
+	static constexpr const char *chars() { return "0123456789abcdef"; }
+};
+
+//! Алфавит base32 (RFC 4648).
+struct Base32Alphabet
+{
+	static constexpr const char *chars() { return "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567"; }
+};
+
+//! Алфавит base62 (совпадает с алфавитом \e PasswordGen по умолчанию).
+struct Base62Alphabet
+{
+	static constexpr const char *chars() { return "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"; }
+};
+
+//! Алфавит base64url (RFC 4648).
+struct Base64UrlAlphabet
+{
+	static constexpr const char *chars() { return "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"; }
+};
+
+//==========================================================================//
+
+//! Таблица номеров символов алфавита (\b 0xff - символ не входит в алфавит).
+struct FixedCharIndex
+{
+	uint8 index[256];	//!< Номер символа в алфавите.
+};
+
+//! Вычисляемые на этапе компиляции функции для \e FixedPasswordGen.
+namespace fixedalgo
+{
+	//! Длина строки.
+	constexpr uint32 length(const char *_str)
+	{
+		uint32 n = 0;
+		while(_str[n])
+			n++;
+		return n;
+	}
+
+	//! Проверка того, что все символы строки различны.
+	constexpr bool distinct(const char *_str)
+	{
+		bool seen[256] = {};
+		for(uint32 i = 0; _str[i]; i++)
+		{
+			if(seen[(uint8)_str[i]])
+				return false;
+			seen[(uint8)_str[i]] = true;
+		}
+		return true;
+	}
+
+	//! Таблица номеров символов строки.
+	constexpr FixedCharIndex charIndex(const char *_str)
+	{
+		FixedCharIndex res = {};
+		for(uint32 i = 0; i < 256; i++)
+			res.index[i] = 0xff;
+		for(uint32 i = 0; _str[i]; i++)
+			res.index[(uint8)_str[i]] = i;
+		return res;
+	}
+
+	//! Квадратный корень (метод Ньютона), \e _x не меньше \b 0.
+	constexpr double sqrt(double _x)
+	{
+		if(_x == 0)
+			return 0;
+		double r = _x > 1 ? _x : 1;
+		for(uint32 i = 0; i < 100; i++)
+		{
+			double next = (r + _x / r) / 2;
+			if(next >= r)
+				break;
+			r = next;
+		}
+		return r;
+	}
+
+	//! Количество битов на символ, если \e _m - степень двойки, иначе \b 0.
+	constexpr uint32 bits(uint32 _m)
+	{
+		uint32 b = 0;
+		while((1U << b) < _m)
+			b++;
+		return (1U << b) == _m ? b : 0;
+	}
+
+	//! Наибольшее \e k, при котором \f$ M^k \le 2^{64} \f$.
+	constexpr uint32 wordDigits(uint32 _m)
+	{
+		unsigned __int128 power = _m;
+		uint32 k = 1;
+		while(power * _m <= (unsigned __int128)1 << 64)
+		{
+			power *= _m;
+			k++;
+		}
+		return k;
+	}
+
+	//! Остаток \f$ 2^{64} \bmod M^k \f$.
+	constexpr uint64 wordReject(uint32 _m, uint32 _k)
+	{
+		unsigned __int128 power = 1;
+		for(uint32 i = 0; i < _k; i++)
+			power *= _m;
+		return ((unsigned __int128)1 << 64) % power;
+	}
+}
+
+//==========================================================================//
+
+//! Класс генератора паролей с алфавитом, заданным на этапе компиляции.
+/*! Работает так же, как \e PasswordGen без политики: символы берутся из последовательности
+	\e password_seq длины \e seqLen, каждая новая последовательность проверяется тестом частот
+	и хи-квадрат и при неудаче вырабатывается заново. Последовательность хранится в самом объекте,
+	память не выделяется.
+*/
+template<typename Alphabet>
+class FixedPasswordGen
+{
+public:
+	static constexpr uint32 size = fixedalgo::length(Alphabet::chars());		//!< Размер алфавита \e M.
+	static_assert(size >= 2 && size <= 255, "alphabet must contain 2..255 characters");
+	static_assert(fixedalgo::distinct(Alphabet::chars()), "alphabet characters must be distinct");
+
+	static constexpr uint32 seqLen = size < 100 ? 1200 : 2400;				//!< Длина последовательности \e password_seq.
+	static constexpr uint32 bits = fixedalgo::bits(size);					//!< Битов на символ (\b 0 - размер не степень двойки).
+	static constexpr uint32 wordDigits = bits ? 64 / bits : fixedalgo::wordDigits(size);	//!< Символов из одного 64-битного слова.
+	static constexpr uint64 wordReject = bits ? 0 : fixedalgo::wordReject(size, wordDigits);	//!< Граница отбрасывания слов.
+	static constexpr FixedCharIndex charIndex = fixedalgo::charIndex(Alphabet::chars());	//!< Таблица номеров символов.
+	static constexpr double b1 = (seqLen - 2.58 * fixedalgo::sqrt(seqLen * (size - 1.))) / size;	//!< Нижняя граница частоты символа.
+	static constexpr double b2 = (seqLen + 2.58 * fixedalgo::sqrt(seqLen * (size - 1.))) / size;	//!< Верхняя граница частоты символа.
+	static constexpr double g1 = (fixedalgo::sqrt(2. * size - 1.) - 2.33) * (fixedalgo::sqrt(2. * size - 1.) - 2.33) / 2.;	//!< Нижняя граница хи-квадрат.
+	static constexpr double g2 = (fixedalgo::sqrt(2. * size - 1.) + 2.33) * (fixedalgo::sqrt(2. * size - 1.) + 2.33) / 2.;	//!< Верхняя граница хи-квадрат.
+
+private:
+	RandomGen rg;						//!< Генератор случайных чисел.
+	char password_seq[seqLen];			//!< Последовательность символов алфавита.
+	uint32 curr_pos;					//!< Текущая позиция в \e password_seq.
+
+public:
+	/*! Конструктор. Производится инициализация генератора случайных чисел \e rg
+		с параметрами \e _seq_size и \e _test_windows (см. <em>RandomGen::RandomGen()</em>).
+	*/
+	FixedPasswordGen(uint32 _seq_size = fipsBlockSize, uint32 _test_windows = 0) : rg(_seq_size, _test_windows), curr_pos(seqLen)
+	{
+		rg.init();
+	}
+
+	//! Алфавит генератора.
+	static const char *alphabeth() { return Alphabet::chars(); }
+
+	//! Генерация пароля длины \e _password_len в строку \e _res.
+	void nextPassword(std::string &_res, uint32 _password_len)
+	{
+		_res.resize(_password_len);
+		if(_password_len)
+			nextChars(&_res[0], _password_len);
+	}
+
+	/*! Генерация \e _count паролей длины \e _password_len в буфер \e _buf с шагом \e _stride
+		(см. <em>PasswordGen::nextPasswords()</em>).
+	*/
+	bool nextPasswords(char *_buf, uint32 _count, uint32 _password_len, uint32 _stride)
+	{
+		if(_stride < _password_len)
+			return false;
+		if(_stride == _password_len)
+		{
+			nextChars(_buf, (uint64)_count * _password_len);
+			return true;
+		}
+		for(uint32 i = 0; i < _count; i++, _buf += _stride)
+		{
+			nextChars(_buf, _password_len);
+			_buf[_password_len] = 0;
+		}
+		return true;
+	}
+
+	//! Запись в \e _dst \e _count очередных символов.
+	void nextChars(char *_dst, uint64 _count)
+	{
+		while(_count)
+		{
+			if(curr_pos == seqLen || rg.forked())
+				createNewPasswordSeq();
+			uint32 n = seqLen - curr_pos < _count ? seqLen - curr_pos : _count;
+			memcpy(_dst, &password_seq[curr_pos], n);
+			curr_pos += n;
+			_dst += n;
+			_count -= n;
+		}
+	}
+
+private:
+	/*! Создание новой проверенной последовательности \e password_seq. Символы извлекаются из
+		случайных 64-битных слов: по \e bits битов, если размер алфавита - степень двойки,
+		иначе цифрами по основанию \e size с отбрасыванием слов из неполного последнего интервала.
+	*/
+	void createNewPasswordSeq()
+	{
+		const char *chars = Alphabet::chars();
+		uint64 words[64];
+		do
+		{
+			uint32 i = 0;
+			uint32 w = 64;
+			while(i < seqLen)
+			{
+				if(w == 64)
+				{
+					rg.nextBytes((uint8*)words, sizeof(words));
+					w = 0;
+				}
+				uint64 x = words[w++];
+				if(bits)
+				{
+					for(uint32 d = 0; d < wordDigits && i < seqLen; d++, x >>= bits)
+						password_seq[i++] = chars[x & (size - 1)];
+					continue;
+				}
+				if(wordReject && x >= -wordReject)
+					continue;
+				for(uint32 d = 0; d < wordDigits && i < seqLen; d++, x /= size)
+					password_seq[i++] = chars[x % size];
+			}
+		}
+		while(!test());
+		memset(words, 0, sizeof(words));
+		curr_pos = 0;
+	}
+
+	//! Проверка частот символов и статистики хи-квадрат последовательности \e password_seq.
+	bool test() const
+	{
+		uint32 m[256] = {0};
+		for(uint32 j = 0; j < seqLen; j++)
+			m[charIndex.index[(uint8)password_seq[j]]]++;
+		const double e = (double)seqLen / size;
+		double hi2 = 0;
+		for(uint32 i = 0; i < size; i++)
+		{
+			if(m[i] < b1 || m[i] > b2)
+				return false;
+			hi2 += (m[i] - e) * (m[i] - e) / e;
+		}
+		return hi2 >= g1 && hi2 <= g2;
+	}
+};
+
+template<typename Alphabet> constexpr FixedCharIndex FixedPasswordGen<Alphabet>::charIndex;
+
+//==========================================================================//
+
+typedef FixedPasswordGen<HexAlphabet> HexPasswordGen;				//!< Генератор шестнадцатеричных паролей.
+typedef FixedPasswordGen<Base32Alphabet> Base32PasswordGen;			//!< Генератор паролей base32.
+typedef FixedPasswordGen<Base62Alphabet> Base62PasswordGen;			//!< Генератор паролей base62.
+typedef FixedPasswordGen<Base64UrlAlphabet> Base64UrlPasswordGen;	//!< Генератор паролей base64url.
+
+//==========================================================================//
+
+#endif
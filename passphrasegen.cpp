@@ -0,0 +1,261 @@
+
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "passphrasegen.h"
+
+/*! \class PassphraseGen
+	Генератор парольных фраз из случайных слов словаря (метод diceware). Файл словаря
+	отображается в память, при открытии один раз строится компактный индекс: смещение и длина
+	каждого слова (5 байтов на слово). Слова в файле разделены переводами строк; строки вида
+	<em>"12345	word"</em> (номер броска костей и слово) обрабатываются как словари diceware,
+	пустые строки и слова длиннее \e maxWordLen пропускаются.
+	\par
+	Номера слов вырабатываются без смещения пакетами с помощью \e BoundedRandom, фразы собираются
+	копированием слов из отображения прямо в буфер вызывающей стороны, память не выделяется.
+	\par Пример:
+	\code
+	PassphraseGen pg;
+	if(!pg.open("/usr/share/dict/eff_large_wordlist.txt"))
+		return;
+	char phrase[256];
+	// 6 слов из 7776 - около 77.5 битов энтропии.
+	pg.nextPassphrase(phrase, sizeof(phrase), 6, '-');
+	\endcode
+*/
+
+//==========================================================================//
+
+/*! Создаёт объект класса без словаря. Производится инициализация генератора случайных чисел \e rg.
+	\param _seq_size - размер последовательности генератора \e rg (см. <em>RandomGen::RandomGen()</em>).
+	\param _test_windows - количество тестируемых окон генератора \e rg.
+*/
+PassphraseGen::PassphraseGen(uint32 _seq_size, uint32 _test_windows) : fd(-1), map(NULL), map_size(0),
+	rg(_seq_size, _test_windows), br(rg)
+{
+	rg.init();
+}
+
+//==========================================================================//
+
+/*! Уничтожает объект класса.
+*/
+PassphraseGen::~PassphraseGen()
+{
+	close();
+}
+
+//==========================================================================//
+
+/*! Открывает словарь и строит индекс слов.
+	\param _path - имя файла словаря.
+	\returns \b true в случае успеха, \b false - если файл недоступен, больше 4 Гб или содержит
+	менее двух слов (причина в \e errno, если файл недоступен).
+*/
+bool PassphraseGen::open(const char *_path)
+{
+	close();
+	fd = ::open(_path, O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) < 0 || !st.st_size || (uint64)st.st_size > 0xffffffffULL)
+	{
+		close();
+		return false;
+	}
+	void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(addr == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	map = (const char*)addr;
+	map_size = st.st_size;
+	madvise((void*)map, map_size, MADV_SEQUENTIAL);
+	buildIndex();
+	if(word_offset.size() < 2)
+	{
+		close();
+		return false;
+	}
+	madvise((void*)map, map_size, MADV_RANDOM);
+	return true;
+}
+
+//==========================================================================//
+
+/*! Закрывает словарь: снимает отображение файла, закрывает его и освобождает индекс.
+*/
+void PassphraseGen::close()
+{
+	if(map)
+		munmap((void*)map, map_size);
+	map = NULL;
+	map_size = 0;
+	if(fd >= 0)
+		::close(fd);
+	fd = -1;
+	std::vector<uint32>().swap(word_offset);
+	std::vector<uint8>().swap(word_len);
+}
+
+//==========================================================================//
+
+/*! Количество слов словаря.
+	\returns Количество слов (\b 0, если словарь не открыт).
+*/
+uint32 PassphraseGen::size() const
+{
+	return word_offset.size();
+}
+
+//==========================================================================//
+
+/*! Энтропия фразы из \e _words слов: \f$ w \log_2 n \f$, где \e n - количество слов словаря.
+	\param _words - количество слов во фразе.
+	\returns Энтропию в битах.
+*/
+double PassphraseGen::entropy(uint32 _words) const
+{
+	return word_offset.empty() ? 0. : _words * log2((double)word_offset.size());
+}
+
+//==========================================================================//
+
+/*! Генерирует фразу из \e _words случайных слов, разделённых символом \e _separator,
+	в буфер \e _buf. Фраза завершается нулём.
+	\param _buf - буфер для фразы.
+	\param _buf_size - размер \e _buf в байтах.
+	\param _words - количество слов.
+	\param _separator - разделитель слов (\b 0 - слова записываются без разделителя).
+	\returns Длину фразы без завершающего нуля или \b 0, если словарь не открыт, \e _words
+	равно нулю или фраза не поместилась в буфер.
+*/
+uint32 PassphraseGen::nextPassphrase(char *_buf, uint32 _buf_size, uint32 _words, char _separator)
+{
+	return assemble(_buf, _buf_size, _words, _separator);
+}
+
+//==========================================================================//
+
+/*! Генерирует фразу из \e _words случайных слов в строку \e _res. Память строки используется повторно.
+	\param _res - строка для результата.
+	\param _words - количество слов.
+	\param _separator - разделитель слов (\b 0 - без разделителя).
+	\returns \b true в случае успеха, \b false - если словарь не открыт или \e _words равно нулю.
+*/
+bool PassphraseGen::nextPassphrase(std::string &_res, uint32 _words, char _separator)
+{
+	if(word_offset.empty() || !_words)
+		return false;
+	_res.resize((uint64)_words * (maxWordLen + 1));
+	uint32 len = assemble(&_res[0], _res.size() + 1, _words, _separator);
+	_res.resize(len);
+	return true;
+}
+
+//==========================================================================//
+
+/*! Генерирует \e _count фраз в буфер \e _buf. Фразы записываются подряд, каждая завершается нулём,
+	смещение начала фразы \e i записывается в <em>_offsets[i]</em>. Генерация прекращается, если
+	очередная фраза не помещается в буфер. Память не выделяется.
+	\param _buf - буфер для фраз.
+	\param _buf_size - размер \e _buf в байтах.
+	\param _count - количество фраз.
+	\param _words - количество слов в каждой фразе.
+	\param _separator - разделитель слов (\b 0 - без разделителя).
+	\param _offsets - массив из \e _count элементов для смещений фраз в \e _buf.
+	\returns Количество сгенерированных фраз.
+*/
+uint32 PassphraseGen::nextPassphrases(char *_buf, uint64 _buf_size, uint32 _count, uint32 _words, char _separator, uint64 *_offsets)
+{
+	uint64 offset = 0;
+	uint32 i;
+	for(i = 0; i < _count; i++)
+	{
+		uint32 len = assemble(_buf + offset, _buf_size - offset, _words, _separator);
+		if(!len)
+			break;
+		_offsets[i] = offset;
+		offset += len + 1;
+	}
+	return i;
+}
+
+//==========================================================================//
+
+/*! Построение индекса слов: для каждой непустой строки файла запоминаются смещение и длина слова.
+	Номер броска костей в начале строки (цифры, за которыми следуют пробелы или табуляция)
+	и пробельные символы по краям слова отбрасываются.
+*/
+void PassphraseGen::buildIndex()
+{
+	word_offset.clear();
+	word_len.clear();
+	const char *p = map;
+	const char *end = map + map_size;
+	while(p < end)
+	{
+		const char *eol = (const char*)memchr(p, '\n', end - p);
+		if(!eol)
+			eol = end;
+		const char *b = p;
+		const char *e = eol;
+		while(b < e && (*b == ' ' || *b == '\t'))
+			b++;
+		const char *d = b;
+		while(d < e && *d >= '0' && *d <= '9')
+			d++;
+		if(d > b && d < e && (*d == ' ' || *d == '\t'))
+		{
+			b = d;
+			while(b < e && (*b == ' ' || *b == '\t'))
+				b++;
+		}
+		while(e > b && (e[-1] == '\r' || e[-1] == ' ' || e[-1] == '\t'))
+			e--;
+		if(e > b && e - b <= maxWordLen)
+		{
+			word_offset.push_back(b - map);
+			word_len.push_back(e - b);
+		}
+		p = eol + 1;
+	}
+	std::vector<uint32>(word_offset).swap(word_offset);
+	std::vector<uint8>(word_len).swap(word_len);
+}
+
+//==========================================================================//
+
+/*! Сборка одной фразы в \e _dst. Номера слов вырабатываются \e br без смещения.
+	\param _dst - буфер для фразы.
+	\param _dst_size - размер \e _dst в байтах.
+	\param _words - количество слов.
+	\param _separator - разделитель слов (\b 0 - без разделителя).
+	\returns Длину фразы без завершающего нуля или \b 0, если фраза не поместилась.
+*/
+uint32 PassphraseGen::assemble(char *_dst, uint64 _dst_size, uint32 _words, char _separator)
+{
+	const uint32 n = word_offset.size();
+	if(!n || !_words || !_dst_size)
+		return 0;
+	uint64 len = 0;
+	for(uint32 i = 0; i < _words; i++)
+	{
+		uint32 w = br.next(n);
+		uint32 l = word_len[w];
+		if(len + l + (i && _separator) + 1 > _dst_size)
+			return 0;
+		if(i && _separator)
+			_dst[len++] = _separator;
+		memcpy(_dst + len, map + word_offset[w], l);
+		len += l;
+	}
+	_dst[len] = 0;
+	return len;
+}
+
+//==========================================================================//
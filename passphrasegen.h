@@ -0,0 +1,51 @@
+
+#ifndef _PASSPHRASEGEN_H_
+#define _PASSPHRASEGEN_H_
+
+#include <string>
+#include <vector>
+
+#include "randomgen.h"
+#include "randomalgo.h"
+
+//==========================================================================//
+
+//! Класс генератора парольных фраз из слов словаря.
+class PassphraseGen
+{
+public:
+	static const uint32 maxWordLen = 255;			//!< Максимальная длина слова словаря.
+
+private:
+	int fd;											//!< Дескриптор файла словаря.
+	const char *map;								//!< Отображение файла словаря в память.
+	uint64 map_size;								//!< Размер отображения в байтах.
+	std::vector<uint32> word_offset;				//!< Смещения слов в файле словаря.
+	std::vector<uint8> word_len;					//!< Длины слов.
+	RandomGen rg;									//!< Генератор случайных чисел.
+	BoundedRandom br;								//!< Источник номеров слов.
+
+public:
+	PassphraseGen(uint32 _seq_size = fipsBlockSize, uint32 _test_windows = 0);	//!< Конструктор.
+	~PassphraseGen();								//!< Деструктор.
+
+	bool open(const char *_path);					//!< Открытие словаря.
+	void close();									//!< Закрытие словаря.
+	uint32 size() const;							//!< Количество слов словаря.
+	double entropy(uint32 _words) const;			//!< Энтропия фразы из \e _words слов в битах.
+
+	uint32 nextPassphrase(char *_buf, uint32 _buf_size, uint32 _words, char _separator = ' ');	//!< Генерация фразы в буфер \e _buf.
+	bool nextPassphrase(std::string &_res, uint32 _words, char _separator = ' ');	//!< Генерация фразы в строку \e _res.
+	uint32 nextPassphrases(char *_buf, uint64 _buf_size, uint32 _count, uint32 _words, char _separator, uint64 *_offsets);	//!< Генерация \e _count фраз в буфер \e _buf.
+
+private:
+	PassphraseGen(const PassphraseGen &);			//!< Копирование запрещено.
+	PassphraseGen &operator=(const PassphraseGen &);	//!< Присваивание запрещено.
+
+	void buildIndex();								//!< Построение индекса слов.
+	uint32 assemble(char *_dst, uint64 _dst_size, uint32 _words, char _separator);	//!< Сборка одной фразы.
+};
+
+//==========================================================================//
+
+#endif
@@ -3,10 +3,16 @@
 #include <stdlib.h>
 #include <cmath>
 #include <new>
+#include <type_traits>
+#include <utility>
 
 using namespace std;
 
 #include "passwordgen.h"
+#include "uniquefilter.h"
+
+// Контейнеры (std::vector) перемещают, а не копируют генераторы только при noexcept-перемещении.
+static_assert(std::is_nothrow_move_constructible<PasswordGen>::value, "PasswordGen move must be noexcept");
 
 /*! \class PasswordGen
 	Класс реализует генератор случайных последовательностей символов алфавита \e alphabeth.
@@ -19,20 +25,148 @@ using namespace std;
 	// TODO
 	delete [] pass;
 	\endcode
+	\par
+	Для генерации большого количества паролей без выделения памяти на каждый пароль
+	используются методы <em>nextPasswords()</em>, записывающие пароли в буфер вызывающей стороны:
+	\code
+	// 1000 паролей длиной 12 символов, каждый завершается нулём.
+	char buf[1000 * 13];
+	pg.nextPasswords(buf, 1000, 12, 13);
+	\endcode
+	\par
+	Алфавит задаётся при создании объекта или политикой \e PasswordPolicy. Требования политики
+	к классам символов выполняются построением пароля, а не повторной генерацией: сначала выбираются
+	обязательные символы каждого класса, остальные берутся из \e password_seq, после чего символы
+	пароля перемешиваются алгоритмом Фишера-Йетса. Поэтому время генерации не зависит от строгости политики.
+	\code
+	PasswordPolicy policy;
+	policy.excludeLookAlikes();
+	policy.addClass("0123456789", 1);
+	policy.addClass("ABCDEFGHIJKLMNOPQRSTUVWXYZ", 2);
+	pg.setPolicy(policy);
+	std::string pass;
+	pg.nextPassword(pass, 12);
+	\endcode
+*/
+
+/*! \class PasswordPolicy
+	Политика генерации паролей: алфавит, исключаемые символы и минимальное количество символов
+	из заданных классов. Символы классов, отсутствующие в алфавите или исключённые, не учитываются.
 */
 
 //==========================================================================//
 
-char PasswordGen::alphabeth[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+char PasswordGen::default_alphabeth[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+const char PasswordPolicy::lookAlikes[] = "0O1lI|";
+
+//==========================================================================//
+
+/*! Построение алфавита из символов \e _src без повторов и без символов \e _excluded.
+	\param _dst - массив не менее чем из 256 символов для алфавита, завершаемого нулём.
+	\param _src - исходные символы.
+	\param _excluded - исключаемые символы.
+	\returns Количество символов алфавита.
+*/
+static uint32 buildAlphabeth(char *_dst, const char *_src, const char *_excluded)
+{
+	bool skip[256] = {false};
+	for(; *_excluded; _excluded++)
+		skip[(uint8)*_excluded] = true;
+	uint32 len = 0;
+	for(; *_src && len < 255; _src++)
+	{
+		if(skip[(uint8)*_src])
+			continue;
+		skip[(uint8)*_src] = true;
+		_dst[len++] = *_src;
+	}
+	_dst[len] = 0;
+	return len;
+}
+
+//==========================================================================//
+
+/*! Создаёт политику без требований к классам символов.
+	\param _alphabeth - алфавит (\b NULL - алфавит генератора по умолчанию).
+*/
+PasswordPolicy::PasswordPolicy(const char *_alphabeth) : alphabeth(_alphabeth ? _alphabeth : "")
+{
+}
+
+//==========================================================================//
+
+/*! Устанавливает алфавит политики.
+	\param _alphabeth - алфавит (\b NULL - алфавит генератора по умолчанию).
+*/
+void PasswordPolicy::setAlphabeth(const char *_alphabeth)
+{
+	alphabeth = _alphabeth ? _alphabeth : "";
+}
+
+//==========================================================================//
+
+/*! Добавляет требование: пароль должен содержать не менее \e _min символов из \e _chars.
+	\param _chars - символы класса.
+	\param _min - минимальное количество символов класса в пароле.
+*/
+void PasswordPolicy::addClass(const char *_chars, uint32 _min)
+{
+	classes.push_back(_chars);
+	minimums.push_back(_min);
+}
+
+//==========================================================================//
+
+/*! Исключает символы \e _chars из алфавита и из классов символов.
+	\param _chars - исключаемые символы.
+*/
+void PasswordPolicy::exclude(const char *_chars)
+{
+	excluded += _chars;
+}
+
+//==========================================================================//
+
+/*! Исключает похожие друг на друга символы \e lookAlikes.
+*/
+void PasswordPolicy::excludeLookAlikes()
+{
+	exclude(lookAlikes);
+}
+
+//==========================================================================//
+
+/*! Подсчитывает количество обязательных символов политики.
+	\returns Сумму минимальных количеств символов всех классов.
+*/
+uint32 PasswordPolicy::required() const
+{
+	uint32 res = 0;
+	for(uint32 i = 0; i < minimums.size(); i++)
+		res += minimums[i];
+	return res;
+}
 
 //==========================================================================//
 
 /*! Создаёт объект класса. Производится инициализация генератора случайных чисел \e rg.
+	\param _alphabeth - алфавит. Повторяющиеся символы отбрасываются. Если параметр равен \b NULL
+	или содержит менее двух различных символов, используется алфавит \e default_alphabeth.
+	\param _seq_size - размер последовательности генератора \e rg (см. <em>RandomGen::RandomGen()</em>).
+	\param _test_windows - количество тестируемых окон генератора \e rg.
 */
-PasswordGen::PasswordGen() : rg(), seq_len(strlen(alphabeth) < 100 ? 1200 : 2400), curr_pos(seq_len)
+PasswordGen::PasswordGen(const char *_alphabeth, uint32 _seq_size, uint32 _test_windows) : required(0), rg(_seq_size, _test_windows)
 {
+	alphabeth_len = buildAlphabeth(alphabeth, _alphabeth ? _alphabeth : default_alphabeth, "");
+	if(alphabeth_len < 2)
+		alphabeth_len = buildAlphabeth(alphabeth, default_alphabeth, "");
+	policy.setAlphabeth(alphabeth);
+	seq_len = alphabeth_len < 100 ? 1200 : 2400;
+	curr_pos = seq_len;
 	password_seq = new char[seq_len];
 	memset(password_seq, 0, seq_len);
+	initTest();
 	rg.init();
 }
 
@@ -41,10 +175,34 @@ PasswordGen::PasswordGen() : rg(), seq_len(strlen(alphabeth) < 100 ? 1200 : 2400
 /*! Создаёт объект класса путём копирования свойств объекта \e pg.
 	\param pg - объкт класса \e PasswordGen.
 */
-PasswordGen::PasswordGen(const PasswordGen &pg) : rg(pg.rg), seq_len(pg.seq_len), curr_pos(pg.curr_pos)
+PasswordGen::PasswordGen(const PasswordGen &pg) : policy(pg.policy), required(pg.required), rg(pg.rg), password_seq(NULL),
+	seq_len(pg.seq_len), curr_pos(pg.curr_pos), alphabeth_len(pg.alphabeth_len), b1(pg.b1), b2(pg.b2), g1(pg.g1), g2(pg.g2),
+	word_digits(pg.word_digits), word_reject(pg.word_reject)
 {
-	password_seq = new char[seq_len];
-	memcpy(password_seq, pg.password_seq, seq_len);
+	memcpy(alphabeth, pg.alphabeth, sizeof(alphabeth));
+	memcpy(char_index, pg.char_index, sizeof(char_index));
+	if(pg.password_seq)
+	{
+		password_seq = new char[seq_len];
+		memcpy(password_seq, pg.password_seq, seq_len);
+	}
+}
+
+//==========================================================================//
+
+/*! Создаёт объект класса путём перемещения свойств объекта \e pg. Последовательность
+	\e password_seq передаётся без копирования. Объект \e pg после перемещения использовать нельзя.
+	\param pg - объкт класса \e PasswordGen.
+*/
+PasswordGen::PasswordGen(PasswordGen &&pg) noexcept : policy(std::move(pg.policy)), required(pg.required), rg(std::move(pg.rg)),
+	password_seq(pg.password_seq), seq_len(pg.seq_len), curr_pos(pg.curr_pos), alphabeth_len(pg.alphabeth_len),
+	b1(pg.b1), b2(pg.b2), g1(pg.g1), g2(pg.g2),
+	word_digits(pg.word_digits), word_reject(pg.word_reject)
+{
+	memcpy(alphabeth, pg.alphabeth, sizeof(alphabeth));
+	memcpy(char_index, pg.char_index, sizeof(char_index));
+	pg.password_seq = NULL;
+	pg.curr_pos = pg.seq_len;
 }
 
 //==========================================================================//
@@ -63,35 +221,331 @@ PasswordGen::~PasswordGen()
 	производится выделение памяти с помощью оператора \b new, поэтому после использования,
 	память должна быть освобождена во избежание утечек.
 	\param password_len - длна генерируемой последовательности.
-	\returns Сгенерированную случайную последовательность символов алфавита.
+	\returns Сгенерированную случайную последовательность символов алфавита или \b NULL,
+	если длина меньше количества обязательных символов политики.
 */
 char *PasswordGen::nextPassword(uint32 password_len)
 {
+	if(password_len < required)
+		return NULL;
 	char *res = new(nothrow) char[password_len + 1];
 	if(!res)
 		return NULL;
-	memset(res, 0, password_len + 1);
-	for(uint32 i = 0; i < password_len; i++)
-		res[i] = getChar();
+	fillPassword(res, password_len);
+	res[password_len] = 0;
 	return res;
 }
 
 //==========================================================================//
 
+/*! Генерирует случайную последовательность символов длины \e _password_len в строку \e _res.
+	Память строки используется повторно, поэтому при генерации в одну и ту же строку
+	выделение памяти происходит только при увеличении длины.
+	\param _res - строка для результата.
+	\param _password_len - длина генерируемой последовательности.
+	\returns \b true в случае успеха, \b false - если длина меньше количества обязательных символов политики.
+*/
+bool PasswordGen::nextPassword(std::string &_res, uint32 _password_len)
+{
+	if(_password_len < required)
+		return false;
+	_res.resize(_password_len);
+	if(_password_len)
+		fillPassword(&_res[0], _password_len);
+	return true;
+}
+
+//==========================================================================//
+
+/*! Генерирует \e _count паролей длины \e _password_len в буфер \e _buf. Пароль с номером \e i
+	записывается по адресу <em>_buf + i * _stride</em>. Если \e _stride больше \e _password_len,
+	после каждого пароля записывается завершающий ноль. Память не выделяется.
+	\param _buf - буфер размером не менее <em>_count * _stride</em> байтов.
+	\param _count - количество паролей.
+	\param _password_len - длина пароля.
+	\param _stride - шаг размещения паролей в буфере.
+	\returns \b true в случае успеха, \b false - если \e _stride меньше \e _password_len
+	или длина меньше количества обязательных символов политики.
+*/
+bool PasswordGen::nextPasswords(char *_buf, uint32 _count, uint32 _password_len, uint32 _stride)
+{
+	if(_stride < _password_len || _password_len < required)
+		return false;
+	if(_stride == _password_len && !required)
+	{
+		getChars(_buf, (uint64)_count * _password_len);
+		return true;
+	}
+	for(uint32 i = 0; i < _count; i++, _buf += _stride)
+	{
+		fillPassword(_buf, _password_len);
+		if(_stride > _password_len)
+			_buf[_password_len] = 0;
+	}
+	return true;
+}
+
+//==========================================================================//
+
+/*! Генерирует пароли с длинами из массива \e _lengths в буфер \e _buf. Пароли записываются
+	подряд, каждый завершается нулём, смещение начала пароля \e i записывается в <em>_offsets[i]</em>.
+	Генерация прекращается, если очередной пароль не помещается в буфер или его длина меньше
+	количества обязательных символов политики. Память не выделяется.
+	\param _buf - буфер для паролей.
+	\param _buf_size - размер \e _buf в байтах.
+	\param _lengths - длины паролей.
+	\param _count - количество паролей.
+	\param _offsets - массив из \e _count элементов для смещений паролей в \e _buf.
+	\returns Количество сгенерированных паролей.
+*/
+uint32 PasswordGen::nextPasswords(char *_buf, uint32 _buf_size, const uint32 *_lengths, uint32 _count, uint32 *_offsets)
+{
+	uint32 offset = 0;
+	uint32 i;
+	for(i = 0; i < _count; i++)
+	{
+		if((uint64)offset + _lengths[i] + 1 > _buf_size || _lengths[i] < required)
+			break;
+		_offsets[i] = offset;
+		fillPassword(_buf + offset, _lengths[i]);
+		offset += _lengths[i];
+		_buf[offset++] = 0;
+	}
+	return i;
+}
+
+//==========================================================================//
+
+/*! Генерирует \e _count паролей длины \e _password_len без повторов в буфер \e _buf (размещение
+	как в <em>nextPasswords()</em>). Каждый пароль проверяется фильтром \e _filter: пароль, который
+	уже встречался в этом или предыдущих вызовах с тем же фильтром, отбрасывается и генерируется
+	заново. Пароли обрабатываются пачками: хэши пачки вычисляются заранее, и данные фильтра
+	загружаются упреждающе, чтобы промахи кэша разных паролей перекрывались.
+	\param _buf - буфер размером не менее <em>_count * _stride</em> байтов.
+	\param _count - количество паролей.
+	\param _password_len - длина пароля.
+	\param _stride - шаг размещения паролей в буфере.
+	\param _filter - фильтр повторов, рассчитанный на все пароли, проверяемые с его помощью.
+	\returns Количество сгенерированных паролей. Меньше \e _count, если \e _stride меньше длины,
+	длина меньше количества обязательных символов политики, фильтр заполнен или пространство
+	паролей исчерпано (подряд отброшено 1000 паролей).
+*/
+uint32 PasswordGen::nextUniquePasswords(char *_buf, uint32 _count, uint32 _password_len, uint32 _stride, UniqueFilter &_filter)
+{
+	const uint32 batch = 64;
+	const uint32 maxRetries = 1000;
+	uint64 hashes[batch];
+	if(_stride < _password_len || _password_len < required)
+		return 0;
+	uint32 done = 0;
+	while(done < _count)
+	{
+		uint32 n = _count - done < batch ? _count - done : batch;
+		char *dst = _buf + (uint64)done * _stride;
+		for(uint32 i = 0; i < n; i++)
+		{
+			fillPassword(dst + (uint64)i * _stride, _password_len);
+			hashes[i] = UniqueFilter::hash(dst + (uint64)i * _stride, _password_len);
+			_filter.prefetch(hashes[i]);
+		}
+		for(uint32 i = 0; i < n; i++, done++)
+		{
+			char *p = dst + (uint64)i * _stride;
+			uint32 retries = 0;
+			while(!_filter.insertHash(hashes[i]))
+			{
+				if(_filter.size() >= _filter.capacity() || ++retries == maxRetries)
+					return done;
+				fillPassword(p, _password_len);
+				hashes[i] = UniqueFilter::hash(p, _password_len);
+			}
+			if(_stride > _password_len)
+				p[_password_len] = 0;
+		}
+	}
+	return done;
+}
+
+//==========================================================================//
+
+/*! Устанавливает политику генерации \e _policy. Алфавит политики (или алфавит \e default_alphabeth)
+	строится без повторяющихся и исключённых символов, классы символов ограничиваются алфавитом.
+	Неиспользованные символы \e password_seq отбрасываются.
+	\param _policy - политика генерации.
+	\returns \b true в случае успеха, \b false - если алфавит содержит менее двух символов или
+	класс с ненулевым минимумом не содержит ни одного символа алфавита. В этом случае политика не меняется.
+*/
+bool PasswordGen::setPolicy(const PasswordPolicy &_policy)
+{
+	char buf[256];
+	uint32 len = buildAlphabeth(buf, _policy.alphabeth.empty() ? default_alphabeth : _policy.alphabeth.c_str(),
+		_policy.excluded.c_str());
+	if(len < 2)
+		return false;
+	bool present[256] = {false};
+	for(uint32 i = 0; i < len; i++)
+		present[(uint8)buf[i]] = true;
+
+	PasswordPolicy filtered(buf);
+	filtered.excluded = _policy.excluded;
+	char chars[256];
+	for(uint32 i = 0; i < _policy.classes.size(); i++)
+	{
+		if(!_policy.minimums[i])
+			continue;
+		uint32 n = 0;
+		bool used[256] = {false};
+		for(const char *c = _policy.classes[i].c_str(); *c; c++)
+			if(present[(uint8)*c] && !used[(uint8)*c])
+			{
+				used[(uint8)*c] = true;
+				chars[n++] = *c;
+			}
+		if(!n)
+			return false;
+		chars[n] = 0;
+		filtered.addClass(chars, _policy.minimums[i]);
+	}
+
+	memcpy(alphabeth, buf, len + 1);
+	alphabeth_len = len;
+	policy = std::move(filtered);
+	required = policy.required();
+	uint32 len_new = alphabeth_len < 100 ? 1200 : 2400;
+	if(seq_len != len_new)
+	{
+		delete [] password_seq;
+		password_seq = NULL;
+		seq_len = len_new;
+	}
+	curr_pos = seq_len;
+	initTest();
+	return true;
+}
+
+//==========================================================================//
+
+/*! Текущий алфавит генератора.
+	\returns Строку символов алфавита.
+*/
+const char *PasswordGen::getAlphabeth() const
+{
+	return alphabeth;
+}
+
+//==========================================================================//
+
+/*! Освобождает последовательность \e password_seq и последовательность генератора \e rg,
+	чтобы простаивающий объект не занимал память под буферы. Неиспользованные символы
+	отбрасываются, при следующей генерации пароля буферы создаются заново.
+*/
+void PasswordGen::compact()
+{
+	delete [] password_seq;
+	password_seq = NULL;
+	curr_pos = seq_len;
+	rg.compact();
+}
+
+//==========================================================================//
+
 /*! Копирует свойства объекта \e pg.
 	\param pg - объект класса \e PasswordGen.
 */
 PasswordGen &PasswordGen::operator=(const PasswordGen &pg)
 {
+	if(this == &pg)
+		return *this;
 	rg = pg.rg;
+	if(seq_len != pg.seq_len || !pg.password_seq)
+	{
+		delete [] password_seq;
+		password_seq = NULL;
+		seq_len = pg.seq_len;
+	}
+	if(pg.password_seq)
+	{
+		if(!password_seq)
+			password_seq = new char[seq_len];
+		memcpy(password_seq, pg.password_seq, seq_len);
+	}
 	curr_pos = pg.curr_pos;
+	memcpy(alphabeth, pg.alphabeth, sizeof(alphabeth));
+	policy = pg.policy;
+	required = pg.required;
+	alphabeth_len = pg.alphabeth_len;
+	memcpy(char_index, pg.char_index, sizeof(char_index));
+	b1 = pg.b1;
+	b2 = pg.b2;
+	g1 = pg.g1;
+	g2 = pg.g2;
+	word_digits = pg.word_digits;
+	word_reject = pg.word_reject;
+	return *this;
+}
+
+//==========================================================================//
+
+/*! Перемещает свойства объекта \e pg. Последовательность \e password_seq передаётся без копирования.
+	\param pg - объект класса \e PasswordGen.
+*/
+PasswordGen &PasswordGen::operator=(PasswordGen &&pg) noexcept
+{
+	if(this == &pg)
+		return *this;
+	rg = std::move(pg.rg);
+	delete [] password_seq;
+	password_seq = pg.password_seq;
 	seq_len = pg.seq_len;
-	memcpy(password_seq, pg.password_seq, seq_len);
+	curr_pos = pg.curr_pos;
+	memcpy(alphabeth, pg.alphabeth, sizeof(alphabeth));
+	policy = std::move(pg.policy);
+	required = pg.required;
+	alphabeth_len = pg.alphabeth_len;
+	memcpy(char_index, pg.char_index, sizeof(char_index));
+	b1 = pg.b1;
+	b2 = pg.b2;
+	g1 = pg.g1;
+	g2 = pg.g2;
+	word_digits = pg.word_digits;
+	word_reject = pg.word_reject;
+	pg.password_seq = NULL;
+	pg.curr_pos = pg.seq_len;
 	return *this;
 }
 
 //==========================================================================//
 
+/*! Расчёт таблицы номеров символов алфавита \e char_index, границ частот символов
+	и статистики хи-квадрат, используемых в <em>test()</em>, и параметров извлечения символов
+	из случайных слов в <em>createNewPasswordSeq()</em>: наибольшего \e k, при котором
+	\f$ M^k \le 2^{64} \f$, и остатка \f$ 2^{64} \bmod M^k \f$. Выполняется при создании объекта
+	и при смене алфавита.
+*/
+void PasswordGen::initTest()
+{
+	memset(char_index, 0xff, sizeof(char_index));
+	for(uint32 i = 0; i < alphabeth_len; i++)
+		char_index[(uint8)alphabeth[i]] = i;
+	const uint32 M = alphabeth_len;
+	const uint32 N = seq_len;
+	b1 = (N - 2.58 * sqrt(N * (M - 1.))) / M;
+	b2 = (N + 2.58 * sqrt(N * (M - 1.))) / M;
+	g1 = pow(sqrt(2. * M - 1.) - 2.33, 2) / 2.;
+	g2 = pow(sqrt(2. * M - 1.) + 2.33, 2) / 2.;
+	const unsigned __int128 limit = (unsigned __int128)1 << 64;
+	unsigned __int128 power = M;
+	word_digits = 1;
+	while(power * M <= limit)
+	{
+		power *= M;
+		word_digits++;
+	}
+	word_reject = limit % power;
+}
+
+//==========================================================================//
+
 /*! Берёт из последовательности \e password_seq очередной символ и увеличивает \e curr_pos.
 	Если \e curr_pos превысил за границы размера \e password_seq, создаётся новая последовательность
 	\e password_seq.
@@ -99,7 +553,7 @@ PasswordGen &PasswordGen::operator=(const PasswordGen &pg)
 */
 char PasswordGen::getChar()
 {
-	if(curr_pos == seq_len)
+	if(curr_pos == seq_len || rg.forked())
 		createNewPasswordSeq();
 	char res = password_seq[curr_pos];
 	curr_pos++;
@@ -108,18 +562,101 @@ char PasswordGen::getChar()
 
 //==========================================================================//
 
+/*! Копирует в \e _dst очередные \e _count символов последовательности \e password_seq
+	целыми фрагментами, при необходимости создавая новые последовательности.
+	\param _dst - массив для символов.
+	\param _count - количество символов.
+*/
+void PasswordGen::getChars(char *_dst, uint64 _count)
+{
+	while(_count)
+	{
+		if(curr_pos == seq_len || rg.forked())
+			createNewPasswordSeq();
+		uint32 n = seq_len - curr_pos < _count ? seq_len - curr_pos : _count;
+		memcpy(_dst, &password_seq[curr_pos], n);
+		curr_pos += n;
+		_dst += n;
+		_count -= n;
+	}
+}
+
+//==========================================================================//
+
+/*! Генерирует один пароль длины \e _password_len с учётом политики: сначала выбираются
+	обязательные символы каждого класса, остальные символы берутся из \e password_seq,
+	затем все символы пароля перемешиваются алгоритмом Фишера-Йетса. Без требований
+	к классам символы просто копируются из \e password_seq. Выбор обязательных символов
+	обращается к \e rg раньше <em>getChars()</em> и при этом сбрасывает признак <em>rg.forked()</em>,
+	поэтому после <em>fork()</em> последовательность \e password_seq заменяется до первого обращения.
+	\param _dst - массив не менее чем из \e _password_len символов.
+	\param _password_len - длина пароля.
+	\returns \b true в случае успеха, \b false - если длина меньше количества обязательных символов.
+*/
+bool PasswordGen::fillPassword(char *_dst, uint32 _password_len)
+{
+	if(rg.forked())
+		createNewPasswordSeq();
+	if(!required)
+	{
+		getChars(_dst, _password_len);
+		return true;
+	}
+	if(_password_len < required)
+		return false;
+	uint32 pos = 0;
+	for(uint32 i = 0; i < policy.classes.size(); i++)
+	{
+		const std::string &chars = policy.classes[i];
+		for(uint32 j = 0; j < policy.minimums[i]; j++)
+			_dst[pos++] = chars[rg.nextBounded(chars.size())];
+	}
+	getChars(_dst + pos, _password_len - pos);
+	for(uint32 i = _password_len; i > 1; i--)
+	{
+		uint32 j = rg.nextBounded(i);
+		if(j != i - 1)
+			std::swap(_dst[i - 1], _dst[j]);
+	}
+	return true;
+}
+
+//==========================================================================//
+
 /*! Создание новой последовательности \e password_seq из символов алфавита \e alphabeth.
+	Случайные 64-битные слова запрашиваются у \e rg пакетами, из каждого слова извлекаются
+	\e word_digits цифр в системе счисления с основанием \e M (размер алфавита). Слова из
+	неполного последнего интервала \f$ [2^{64} - 2^{64} \bmod M^k, 2^{64}) \f$ отбрасываются, поэтому
+	символы распределены равномерно, а на символ расходуется около \f$ \log_2 M \f$ случайных битов.
 	После создание производится проверка качества последовательности и в случае необходимости
 	цикл повторяется. Указатель \e curr_pos сбрасывается в \b 0.
 */
 void PasswordGen::createNewPasswordSeq()
 {
+	if(!password_seq)
+		password_seq = new char[seq_len];
+	const uint32 M = alphabeth_len;
+	uint64 words[64];
 	do
 	{
-		for(uint32 i = 0; i < seq_len; i++)
-			password_seq[i] = alphabeth[rg.nextInt8() % strlen(alphabeth)];
+		uint32 i = 0;
+		uint32 w = 64;
+		while(i < seq_len)
+		{
+			if(w == 64)
+			{
+				rg.nextBytes((uint8*)words, sizeof(words));
+				w = 0;
+			}
+			uint64 x = words[w++];
+			if(word_reject && x >= -word_reject)
+				continue;
+			for(uint32 d = 0; d < word_digits && i < seq_len; d++, x /= M)
+				password_seq[i++] = alphabeth[x % M];
+		}
 	}
 	while(!isCurrentSeq());
+	memset(words, 0, sizeof(words));
 	curr_pos = 0;
 }
 
@@ -136,30 +673,27 @@ bool PasswordGen::isCurrentSeq() const
 
 //==========================================================================//
 
-/*! Проверка качества текущей последовательности \e password_seq.
+/*! Проверка качества текущей последовательности \e password_seq. Частоты символов
+	подсчитываются за один проход по последовательности с помощью таблицы \e char_index,
+	границы рассчитаны заранее в <em>initTest()</em>.
 	\returns \b true - в случае успеха, \b false - иначе.
 */
 bool PasswordGen::test() const
 {
-	const uint32 M  = strlen(alphabeth);
-	uint32 N = seq_len;
-	uint32 m[M];
-	memset(m, 0, sizeof(m));
-	const float b1 = (N - 2.58 * sqrt(N * (M - 1.))) / M;
-	const float b2 = (N + 2.58 * sqrt(N * (M - 1.))) / M;
-	const float g1 = pow(sqrt(2. * M - 1.) - 2.33, 2) / 2.;
-	const float g2 = pow(sqrt(2. * M - 1.) + 2.33, 2) / 2.;
+	const uint32 M = alphabeth_len;
+	const uint32 N = seq_len;
+	uint32 m[256] = {0};
+	for(uint32 j = 0; j < N; j++)
+		m[char_index[(uint8)password_seq[j]]]++;
+	if(m[0xff])
+		return false;
 	for(uint32 i = 0; i < M; i++)
-	{
-		for(uint32 j = 0; j < N; j++)
-			if(password_seq[j] == alphabeth[i])
-				m[i]++;
 		if(m[i] < b1 || m[i] > b2)
 			return false;
-	}
+	const float e = (float)N / M;
 	float hi2 = 0;
 	for(uint32 i = 0; i < M; i++)
-		hi2 += pow(m[i] - (float)N / M, 2) / ((float)N / M);
+		hi2 += (m[i] - e) * (m[i] - e) / e;
 	if(hi2 < g1 || hi2 > g2)
 		return false;
 	return true;
@@ -2,31 +2,85 @@
 #ifndef _PASSWORDGEN_H_
 #define _PASSWORDGEN_H_
 
+#include <string>
+#include <vector>
+
 #include "randomgen.h"
 
+class UniqueFilter;
+
+//==========================================================================//
+
+//! Класс политики генерации паролей.
+class PasswordPolicy
+{
+	friend class PasswordGen;
+
+private:
+	std::string alphabeth;							//!< Алфавит (пустой - алфавит по умолчанию).
+	std::string excluded;							//!< Исключаемые символы.
+	std::vector<std::string> classes;				//!< Классы символов.
+	std::vector<uint32> minimums;					//!< Минимальное количество символов каждого класса.
+
+public:
+	static const char lookAlikes[];					//!< Похожие друг на друга символы.
+
+	PasswordPolicy(const char *_alphabeth = NULL);	//!< Конструктор.
+
+	void setAlphabeth(const char *_alphabeth);		//!< Установка алфавита.
+	void addClass(const char *_chars, uint32 _min);	//!< Добавление требования к классу символов.
+	void exclude(const char *_chars);				//!< Исключение символов.
+	void excludeLookAlikes();						//!< Исключение похожих символов.
+	uint32 required() const;						//!< Количество обязательных символов.
+};
+
 //==========================================================================//
 
 //! Класс генератора паролей.
 class PasswordGen
 {
 private:
-	static char alphabeth[];						//!< Алфавит.
+	static char default_alphabeth[];				//!< Алфавит по умолчанию.
+	char alphabeth[256];							//!< Алфавит.
+	PasswordPolicy policy;							//!< Политика генерации (классы без исключённых символов).
+	uint32 required;								//!< Количество обязательных символов политики.
 	RandomGen rg;									//!< Генератор случайных чисел.
 	char *password_seq;								//!< Текущая последовательность для выработки паролей.
 	uint32 seq_len;									//!< Длина последовательности \e password_seq.
 	uint32 curr_pos;								//!< Текущая позиция в \e password_seq.
+	uint32 alphabeth_len;							//!< Количество символов алфавита.
+	uint8 char_index[256];							//!< Номера символов в алфавите (\b 0xff - символ не из алфавита).
+	float b1, b2;									//!< Границы частоты каждого символа для <em>test()</em>.
+	float g1, g2;									//!< Границы статистики хи-квадрат для <em>test()</em>.
+	uint32 word_digits;								//!< Количество символов, извлекаемых из одного 64-битного слова.
+	uint64 word_reject;								//!< Остаток \f$ 2^{64} \bmod M^k \f$: граница отбрасывания слов.
 
 public:
-	PasswordGen();									//!< Конструктор.
+	PasswordGen(const char *_alphabeth = NULL, uint32 _seq_size = fipsBlockSize, uint32 _test_windows = 0);	//!< Конструктор.
 	PasswordGen(const PasswordGen &pg);				//!< Конструктор копирования.
+	PasswordGen(PasswordGen &&pg) noexcept;			//!< Конструктор перемещения.
 	~PasswordGen();									//!< Деструктор.
 
 	char * nextPassword(uint32 password_len);		//!< Генерация пароля длиной \e password_len.
+	bool nextPassword(std::string &_res, uint32 _password_len);	//!< Генерация пароля в строку \e _res.
+	bool nextPasswords(char *_buf, uint32 _count, uint32 _password_len, uint32 _stride);	//!< Генерация паролей с фиксированным шагом.
+	uint32 nextPasswords(char *_buf, uint32 _buf_size, const uint32 *_lengths, uint32 _count, uint32 *_offsets);	//!< Генерация паролей разной длины.
+
+	uint32 nextUniquePasswords(char *_buf, uint32 _count, uint32 _password_len, uint32 _stride, UniqueFilter &_filter);	//!< Генерация паролей без повторов.
+
+	bool setPolicy(const PasswordPolicy &_policy);	//!< Установка политики генерации.
+	const char *getAlphabeth() const;				//!< Текущий алфавит.
+
+	void compact();									//!< Освобождение последовательностей на время простоя.
 
 	PasswordGen &operator=(const PasswordGen &pg);	//!< Оператор присваивания.
+	PasswordGen &operator=(PasswordGen &&pg) noexcept;	//!< Оператор перемещающего присваивания.
 
 private:
+	void initTest();								//!< Расчёт таблицы символов и границ для <em>test()</em>.
 	char getChar();									//!< Получение очередного символа из последовательности \e password_seq.
+	void getChars(char *_dst, uint64 _count);		//!< Получение \e _count очередных символов из \e password_seq.
+	bool fillPassword(char *_dst, uint32 _password_len);	//!< Генерация одного пароля с учётом политики.
 	void createNewPasswordSeq();					//!< Создание новой последовательности \e password_seq.
 	bool isCurrentSeq() const;						//!< Проверка корректности текущей последовательности \e password_seq.
 	bool test() const;								//!< Проверка качества последовательности \e password_seq.
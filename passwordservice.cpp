@@ -0,0 +1,260 @@
+
+#include <string.h>
+
+#include <vector>
+
+#include "passwordservice.h"
+
+/*! \class PasswordService
+	Сервис генерации паролей для многопоточных приложений. Каждый поток, обращающийся к сервису,
+	получает собственный набор генераторов \e PasswordGen (по одному на каждый используемый алфавит)
+	со своими \e RandomGen и последовательностями символов. Наборы потока хранятся в локальном
+	для потока списке по номерам сервисов, поэтому на основном пути генерации блокировки
+	не используются, в том числе при поочерёдном обращении к нескольким сервисам.
+	Блокировка берётся только при первом обращении потока к сервису. При завершении потока
+	его наборы удаляются из всех ещё существующих сервисов.
+	\par
+	Генератор для нового алфавита создаётся при первом запросе с этим алфавитом (это включает
+	полную инициализацию <em>RandomGen::init()</em>). В каждом потоке хранится не более
+	\e max_alphabeths генераторов, давно не использовавшиеся удаляются.
+	\par Пример:
+	\code
+	PasswordService service;
+	// В любом потоке, без внешней блокировки:
+	std::string pass;
+	service.nextPassword(pass, 12);
+	service.nextPassword(pass, 6, "0123456789");
+	\endcode
+*/
+
+//==========================================================================//
+
+//! Генераторы одного потока.
+struct PasswordService::Shard
+{
+	std::vector<std::string> alphabeths;			//!< Алфавиты генераторов (пустая строка - алфавит по умолчанию).
+	std::vector<PasswordGen*> gens;					//!< Генераторы, последний использованный - первый.
+
+	~Shard()
+	{
+		for(uint32 i = 0; i < gens.size(); i++)
+			delete gens[i];
+	}
+};
+
+//! Наборы генераторов одного потока во всех сервисах, к которым он обращался.
+struct PasswordService::LocalShards
+{
+	std::vector<uint64> ids;						//!< Номера сервисов.
+	std::vector<Shard*> shards;						//!< Наборы генераторов потока в сервисах \e ids.
+
+	~LocalShards();
+};
+
+std::atomic<uint64> PasswordService::next_id(1);
+std::mutex PasswordService::services_mutex;
+thread_local PasswordService::LocalShards PasswordService::local_shards;
+
+//==========================================================================//
+
+/*! Освобождает наборы генераторов завершающегося потока в ещё существующих сервисах.
+	Наборы уничтоженных сервисов уже удалены их деструкторами.
+*/
+PasswordService::LocalShards::~LocalShards()
+{
+	std::lock_guard<std::mutex> lock(services_mutex);
+	for(uint32 i = 0; i < ids.size(); i++)
+	{
+		std::map<uint64, PasswordService*>::iterator it = services().find(ids[i]);
+		if(it == services().end())
+			continue;
+		PasswordService *service = it->second;
+		std::lock_guard<std::mutex> shard_lock(service->mutex);
+		service->shards.erase(std::this_thread::get_id());
+		delete shards[i];
+	}
+}
+
+//==========================================================================//
+
+/*! Создаёт сервис. Генераторы создаются при первом обращении потоков.
+	\param _seq_size - размер последовательности \e RandomGen генераторов.
+	\param _test_windows - количество тестируемых окон \e RandomGen генераторов.
+	\param _max_alphabeths - максимальное количество алфавитов (генераторов) в одном потоке.
+*/
+PasswordService::PasswordService(uint32 _seq_size, uint32 _test_windows, uint32 _max_alphabeths) :
+	id(next_id.fetch_add(1)), seq_size(_seq_size), test_windows(_test_windows),
+	max_alphabeths(_max_alphabeths ? _max_alphabeths : 1)
+{
+	std::lock_guard<std::mutex> lock(services_mutex);
+	services()[id] = this;
+}
+
+//==========================================================================//
+
+/*! Уничтожает сервис и генераторы всех потоков. Во время уничтожения потоки не должны
+	обращаться к сервису.
+*/
+PasswordService::~PasswordService()
+{
+	{
+		// После удаления из списка завершающиеся потоки не обращаются к наборам сервиса.
+		std::lock_guard<std::mutex> lock(services_mutex);
+		services().erase(id);
+	}
+	for(std::map<std::thread::id, Shard*>::iterator it = shards.begin(); it != shards.end(); ++it)
+		delete it->second;
+}
+
+//==========================================================================//
+
+/*! Генерирует пароль длины \e _password_len в буфер \e _buf и завершает его нулём.
+	\param _buf - буфер не менее чем из <em>_password_len + 1</em> символов.
+	\param _password_len - длина пароля.
+	\param _alphabeth - алфавит (\b NULL - алфавит \e PasswordGen по умолчанию).
+	\returns \b true в случае успеха.
+*/
+bool PasswordService::nextPassword(char *_buf, uint32 _password_len, const char *_alphabeth)
+{
+	return generator(_alphabeth).nextPasswords(_buf, 1, _password_len, _password_len + 1);
+}
+
+//==========================================================================//
+
+/*! Генерирует пароль длины \e _password_len в строку \e _res.
+	\param _res - строка для результата.
+	\param _password_len - длина пароля.
+	\param _alphabeth - алфавит (\b NULL - алфавит \e PasswordGen по умолчанию).
+	\returns \b true в случае успеха.
+*/
+bool PasswordService::nextPassword(std::string &_res, uint32 _password_len, const char *_alphabeth)
+{
+	return generator(_alphabeth).nextPassword(_res, _password_len);
+}
+
+//==========================================================================//
+
+/*! Генерирует \e _count паролей в буфер \e _buf (см. <em>PasswordGen::nextPasswords()</em>).
+	\param _buf - буфер размером не менее <em>_count * _stride</em> байтов.
+	\param _count - количество паролей.
+	\param _password_len - длина пароля.
+	\param _stride - шаг размещения паролей в буфере.
+	\param _alphabeth - алфавит (\b NULL - алфавит \e PasswordGen по умолчанию).
+	\returns \b true в случае успеха, \b false - если \e _stride меньше \e _password_len.
+*/
+bool PasswordService::nextPasswords(char *_buf, uint32 _count, uint32 _password_len, uint32 _stride, const char *_alphabeth)
+{
+	return generator(_alphabeth).nextPasswords(_buf, _count, _password_len, _stride);
+}
+
+//==========================================================================//
+
+/*! Количество работающих потоков, обращавшихся к сервису.
+*/
+uint32 PasswordService::shardCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return shards.size();
+}
+
+//==========================================================================//
+
+/*! Список существующих сервисов. Создаётся при первом обращении, поэтому доступен
+	из конструкторов и деструкторов статических объектов \e PasswordService.
+	\returns Сервисы по номерам.
+*/
+std::map<uint64, PasswordService*> &PasswordService::services()
+{
+	static std::map<uint64, PasswordService*> res;
+	return res;
+}
+
+//==========================================================================//
+
+/*! Находит набор генераторов текущего потока в локальном для потока списке (без блокировки).
+	Номера сервисов не повторяются, поэтому список не может указать на набор уничтоженного
+	сервиса. Если поток обращается к сервису впервые, набор создаётся.
+	\returns Набор генераторов текущего потока.
+*/
+PasswordService::Shard *PasswordService::localShard()
+{
+	LocalShards &local = local_shards;
+	for(uint32 i = 0; i < local.ids.size(); i++)
+		if(local.ids[i] == id)
+			return local.shards[i];
+	return createShard();
+}
+
+//==========================================================================//
+
+/*! Создаёт набор генераторов текущего потока и регистрирует его в сервисе и в локальном
+	для потока списке. Из списка заодно удаляются записи уничтоженных сервисов.
+	\returns Набор генераторов текущего потока.
+*/
+PasswordService::Shard *PasswordService::createShard()
+{
+	LocalShards &local = local_shards;
+	Shard *shard = new Shard;
+	{
+		std::lock_guard<std::mutex> lock(services_mutex);
+		uint32 n = 0;
+		for(uint32 i = 0; i < local.ids.size(); i++)
+			if(services().count(local.ids[i]))
+			{
+				local.ids[n] = local.ids[i];
+				local.shards[n] = local.shards[i];
+				n++;
+			}
+		local.ids.resize(n);
+		local.shards.resize(n);
+
+		std::lock_guard<std::mutex> shard_lock(mutex);
+		shards[std::this_thread::get_id()] = shard;
+	}
+	local.ids.push_back(id);
+	local.shards.push_back(shard);
+	return shard;
+}
+
+//==========================================================================//
+
+/*! Находит генератор текущего потока для алфавита \e _alphabeth. Генераторы потока
+	упорядочены по времени использования, поэтому поиск обычно завершается на первом.
+	Новый генератор создаётся без блокировок сервиса; при превышении \e max_alphabeths
+	удаляется давно не использовавшийся.
+	\param _alphabeth - алфавит (\b NULL - алфавит по умолчанию).
+	\returns Генератор.
+*/
+PasswordGen &PasswordService::generator(const char *_alphabeth)
+{
+	Shard *shard = localShard();
+	const char *key = _alphabeth ? _alphabeth : "";
+	uint32 i = 0;
+	for(; i < shard->gens.size(); i++)
+		if(!strcmp(shard->alphabeths[i].c_str(), key))
+			break;
+	if(i == shard->gens.size())
+	{
+		if(i == max_alphabeths)
+		{
+			i--;
+			delete shard->gens[i];
+			shard->gens[i] = NULL;
+		}
+		else
+		{
+			shard->gens.push_back(NULL);
+			shard->alphabeths.push_back(std::string());
+		}
+		shard->gens[i] = new PasswordGen(_alphabeth, seq_size, test_windows);
+		shard->alphabeths[i] = key;
+	}
+	for(; i > 0; i--)
+	{
+		std::swap(shard->gens[i], shard->gens[i - 1]);
+		std::swap(shard->alphabeths[i], shard->alphabeths[i - 1]);
+	}
+	return *shard->gens[0];
+}
+
+//==========================================================================//
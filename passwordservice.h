@@ -0,0 +1,55 @@
+
+#ifndef _PASSWORDSERVICE_H_
+#define _PASSWORDSERVICE_H_
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "passwordgen.h"
+
+//==========================================================================//
+
+//! Класс потокобезопасного сервиса генерации паролей с отдельным генератором для каждого потока.
+class PasswordService
+{
+private:
+	struct Shard;
+	struct LocalShards;
+
+	static std::atomic<uint64> next_id;				//!< Номер следующего создаваемого сервиса.
+	static std::mutex services_mutex;				//!< Блокировка списка существующих сервисов.
+	static thread_local LocalShards local_shards;	//!< Наборы генераторов текущего потока.
+	const uint64 id;								//!< Уникальный номер сервиса.
+	const uint32 seq_size;							//!< Размер последовательности \e RandomGen генераторов.
+	const uint32 test_windows;						//!< Количество тестируемых окон \e RandomGen генераторов.
+	const uint32 max_alphabeths;					//!< Максимальное количество алфавитов в одном потоке.
+	mutable std::mutex mutex;						//!< Блокировка списка потоков.
+	std::map<std::thread::id, Shard*> shards;		//!< Генераторы потоков.
+
+public:
+	PasswordService(uint32 _seq_size = fipsBlockSize, uint32 _test_windows = 0, uint32 _max_alphabeths = 8);	//!< Конструктор.
+	~PasswordService();								//!< Деструктор.
+
+	bool nextPassword(char *_buf, uint32 _password_len, const char *_alphabeth = NULL);	//!< Генерация пароля в буфер \e _buf.
+	bool nextPassword(std::string &_res, uint32 _password_len, const char *_alphabeth = NULL);	//!< Генерация пароля в строку \e _res.
+	bool nextPasswords(char *_buf, uint32 _count, uint32 _password_len, uint32 _stride, const char *_alphabeth = NULL);	//!< Генерация \e _count паролей.
+
+	uint32 shardCount() const;						//!< Количество работающих потоков, использовавших сервис.
+
+private:
+	PasswordService(const PasswordService &);		//!< Копирование запрещено.
+	PasswordService &operator=(const PasswordService &);	//!< Присваивание запрещено.
+
+	static std::map<uint64, PasswordService*> &services();	//!< Существующие сервисы по номерам.
+
+	Shard *localShard();							//!< Генераторы текущего потока.
+	Shard *createShard();							//!< Создание генераторов текущего потока.
+	PasswordGen &generator(const char *_alphabeth);	//!< Генератор текущего потока для алфавита \e _alphabeth.
+};
+
+//==========================================================================//
+
+#endif
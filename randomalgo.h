@@ -0,0 +1,282 @@
+
+#ifndef _RANDOMALGO_H_
+#define _RANDOMALGO_H_
+
+#include <unistd.h>
+#include <cmath>
+
+#include <utility>
+#include <vector>
+
+#include "randomgen.h"
+
+/*! \file randomalgo.h
+	Алгоритмы перемешивания и выборки на основе \e RandomGen. Ограниченные случайные числа
+	вырабатываются без смещения (в отличие от <em>nextInt32() % n</em>) и пакетами, с помощью
+	класса \e BoundedRandom.
+	\par Пример:
+	\code
+	RandomGen rg;
+	rg.init();
+	std::vector<int> shards(1000000);
+	// ...
+	shuffle(rg, &shards[0], shards.size());
+	int chosen[100];
+	sample(rg, &shards[0], shards.size(), chosen, 100);
+	\endcode
+*/
+
+//==========================================================================//
+
+//! Класс пакетной выработки равномерных ограниченных случайных чисел.
+/*! Случайные 32-битные слова запрашиваются у \e RandomGen пакетами по \e batchSize
+	с помощью <em>RandomGen::nextBytes()</em> и преобразуются в числа из [0, n) методом Лемира
+	(умножение со сдвигом и редким отбрасыванием). Неиспользованные слова пакета
+	отбрасываются при уничтожении объекта.
+*/
+class BoundedRandom
+{
+public:
+	static const uint32 batchSize = 256;	//!< Количество слов в пакете.
+
+private:
+	RandomGen &rg;							//!< Генератор случайных чисел.
+	uint32 batch[batchSize];				//!< Текущий пакет случайных слов.
+	uint32 pos;								//!< Текущая позиция в \e batch.
+
+public:
+	//! Конструктор.
+	explicit BoundedRandom(RandomGen &_rg) : rg(_rg), pos(batchSize) {}
+
+	//! Очередное случайное 32-битное слово. После \e fork() остаток пакета отбрасывается.
+	uint32 nextInt32()
+	{
+		if(pos == batchSize || rg.forked())
+		{
+			rg.nextBytes((uint8*)batch, sizeof(batch));
+			pos = 0;
+		}
+		return batch[pos++];
+	}
+
+	//! Равномерное случайное число из [0, \e _bound), \e _bound больше \b 0.
+	uint32 next(uint32 _bound)
+	{
+		uint64 m = (uint64)nextInt32() * _bound;
+		uint32 l = m;
+		if(l < _bound)
+		{
+			uint32 t = -_bound % _bound;
+			while(l < t)
+			{
+				m = (uint64)nextInt32() * _bound;
+				l = m;
+			}
+		}
+		return m >> 32;
+	}
+
+	//! Равномерное случайное число из интервала (0, 1).
+	double nextDouble()
+	{
+		uint64 x = ((uint64)nextInt32() << 32) | nextInt32();
+		return ((x >> 11) + 0.5) * (1. / 9007199254740992.);
+	}
+
+	//! Заполнение \e _res \e _count числами из [0, \e _bound).
+	void next(uint32 _bound, uint32 *_res, uint32 _count)
+	{
+		for(uint32 i = 0; i < _count; i++)
+			_res[i] = next(_bound);
+	}
+
+private:
+	BoundedRandom(const BoundedRandom &);				//!< Копирование запрещено.
+	BoundedRandom &operator=(const BoundedRandom &);	//!< Присваивание запрещено.
+};
+
+//==========================================================================//
+
+/*! Размер кэша второго уровня в байтах (если не удаётся определить - 256 Кб).
+	Массивы большего размера перемешиваются блочным алгоритмом.
+*/
+inline uint64 shuffleCacheSize()
+{
+	static uint64 size = 0;
+	if(!size)
+	{
+		long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+		size = l2 > 0 ? l2 : 256 * 1024;
+	}
+	return size;
+}
+
+//==========================================================================//
+
+/*! Перемешивание массива по алгоритму Фишера-Йетса.
+	\param _br - источник ограниченных случайных чисел.
+	\param _data - перемешиваемый массив.
+	\param _size - количество элементов \e _data.
+*/
+template<typename T>
+void fisherYates(BoundedRandom &_br, T *_data, uint32 _size)
+{
+	for(uint32 i = _size; i > 1; i--)
+	{
+		uint32 j = _br.next(i);
+		if(j != i - 1)
+			std::swap(_data[i - 1], _data[j]);
+	}
+}
+
+//==========================================================================//
+
+/*! Перемешивание массива. Все перестановки равновероятны. Массивы, не помещающиеся
+	в кэш второго уровня, перемешиваются блочно (алгоритм Рао-Санделиуса): каждому элементу
+	назначается случайный номер одного из 256 блоков, элементы раскладываются по блокам
+	за один последовательный проход, после чего каждый блок перемешивается отдельно.
+	Тип \e T должен допускать создание по умолчанию и перемещающее присваивание.
+	\param _rg - генератор случайных чисел.
+	\param _data - перемешиваемый массив.
+	\param _size - количество элементов \e _data.
+*/
+template<typename T>
+void shuffle(RandomGen &_rg, T *_data, uint32 _size)
+{
+	if((uint64)_size * sizeof(T) <= shuffleCacheSize())
+	{
+		BoundedRandom br(_rg);
+		fisherYates(br, _data, _size);
+		return;
+	}
+
+	// Случайный байт - равномерно распределённый номер блока.
+	std::vector<uint8> labels(_size);
+	_rg.nextBytes(&labels[0], _size);
+	uint32 offsets[257] = {0};
+	for(uint32 i = 0; i < _size; i++)
+		offsets[labels[i] + 1]++;
+	for(uint32 b = 1; b <= 256; b++)
+		offsets[b] += offsets[b - 1];
+
+	std::vector<T> tmp(_size);
+	uint32 pos[256];
+	for(uint32 b = 0; b < 256; b++)
+		pos[b] = offsets[b];
+	for(uint32 i = 0; i < _size; i++)
+		tmp[pos[labels[i]]++] = std::move(_data[i]);
+	for(uint32 i = 0; i < _size; i++)
+		_data[i] = std::move(tmp[i]);
+	std::vector<T>().swap(tmp);
+	std::vector<uint8>().swap(labels);
+
+	for(uint32 b = 0; b < 256; b++)
+		shuffle(_rg, _data + offsets[b], offsets[b + 1] - offsets[b]);
+}
+
+//==========================================================================//
+
+/*! Выборка без возвращения \e _count элементов массива \e _src (алгоритм L резервуарной
+	выборки). Количество обращений к генератору пропорционально
+	\f$ k (1 + \log(n / k)) \f$, а не размеру массива. Порядок элементов выборки случаен.
+	Если \e _count не меньше \e _size, в \e _res копируется перемешанный массив \e _src.
+	\param _rg - генератор случайных чисел.
+	\param _src - исходный массив.
+	\param _size - количество элементов \e _src.
+	\param _res - массив для результата, не менее <em>min(_count, _size)</em> элементов.
+	\param _count - размер выборки.
+	\returns Количество элементов выборки.
+*/
+template<typename T>
+uint32 sample(RandomGen &_rg, const T *_src, uint32 _size, T *_res, uint32 _count)
+{
+	if(_count > _size)
+		_count = _size;
+	if(!_count)
+		return 0;
+	for(uint32 i = 0; i < _count; i++)
+		_res[i] = _src[i];
+	BoundedRandom br(_rg);
+	double w = exp(log(br.nextDouble()) / _count);
+	uint64 i = _count - 1;
+	while(true)
+	{
+		i += (uint64)floor(log(br.nextDouble()) / log1p(-w)) + 1;
+		if(i >= _size)
+			break;
+		_res[br.next(_count)] = _src[i];
+		w *= exp(log(br.nextDouble()) / _count);
+	}
+	fisherYates(br, _res, _count);
+	return _count;
+}
+
+//==========================================================================//
+
+//! Класс резервуарной выборки из потока элементов заранее неизвестной длины.
+/*! Хранит равномерную выборку без возвращения \e count элементов из всех добавленных
+	элементов (алгоритм L): большинство элементов пропускается без обращения к генератору.
+	\par Пример:
+	\code
+	ReservoirSampler<int> rs(rg, 10);
+	while(...)
+		rs.add(value);
+	// rs.items() - 10 случайных элементов потока.
+	\endcode
+*/
+template<typename T>
+class ReservoirSampler
+{
+private:
+	BoundedRandom br;			//!< Источник ограниченных случайных чисел.
+	std::vector<T> reservoir;	//!< Текущая выборка.
+	uint32 count;				//!< Размер выборки.
+	uint64 seen;				//!< Количество добавленных элементов.
+	uint64 next_index;			//!< Номер следующего элемента, попадающего в выборку.
+	double w;					//!< Параметр алгоритма L.
+
+public:
+	//! Конструктор выборки размера \e _count (больше \b 0).
+	ReservoirSampler(RandomGen &_rg, uint32 _count) : br(_rg), count(_count), seen(0), next_index(0), w(1.)
+	{
+		reservoir.reserve(count);
+	}
+
+	//! Добавление элемента потока.
+	void add(const T &_item)
+	{
+		if(reservoir.size() < count)
+		{
+			reservoir.push_back(_item);
+			if(reservoir.size() == count)
+			{
+				w = exp(log(br.nextDouble()) / count);
+				skip();
+			}
+		}
+		else if(seen == next_index)
+		{
+			reservoir[br.next(count)] = _item;
+			w *= exp(log(br.nextDouble()) / count);
+			skip();
+		}
+		seen++;
+	}
+
+	//! Текущая выборка (порядок элементов не случаен).
+	const std::vector<T> &items() const { return reservoir; }
+
+	//! Количество добавленных элементов.
+	uint64 size() const { return seen; }
+
+private:
+	//! Выбор номера следующего элемента, попадающего в выборку.
+	void skip()
+	{
+		next_index = seen + (uint64)floor(log(br.nextDouble()) / log1p(-w)) + 1;
+	}
+};
+
+//==========================================================================//
+
+#endif
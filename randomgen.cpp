@@ -3,6 +3,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <type_traits>
+#include <utility>
 
 #include "randomgen.h"
 
@@ -16,15 +20,158 @@
 	rg.init();
 	int n = rg.nextInt32();
 	\endcode
+	\par
+	По умолчанию последовательность \e rand_seq имеет размер одного блока FIPS 140-1
+	(20000 бит), и при каждом её обновлении выполняется полный набор тестов. Для выработки
+	больших объёмов случайных чисел размер последовательности можно увеличить (например, до 1 Мб),
+	тогда фиксированные затраты на обновление распределяются на больший объём данных.
+	Каждый байт последовательности получается шифрованием байта, прочитанного из <b>/dev/urandom</b>,
+	поэтому генератор расходует энтропию ядра байт в байт, а его скорость ограничена скоростью
+	шифрования (гаммирование с обратной связью, порядка 20 МиБ/с на ядро) и ниже скорости
+	чтения <b>/dev/urandom</b>.
+	Тесты выполняются над окнами по \e fipsBlockSize байт, причём можно задать количество
+	проверяемых при каждом обновлении окон:
+	\code
+	// Последовательность около 1 Мб, при каждом обновлении проверяются 16 окон.
+	RandomGen rg(1 << 20, 16);
+	rg.init();
+	\endcode
+	\par
+	Генератор ведёт статистику своей работы (количество обновлений последовательности, отказов
+	тестов и проверок \e S, чтений <b>/dev/urandom</b>, выданных байтов и гистограммы задержек),
+	которую можно получить из любого потока методом <em>getStats()</em> и обнулить методом
+	<em>resetStats()</em>.
+	\par
+	Генератор безопасен при вызове <em>fork()</em>: дочерний процесс, получивший копию
+	состояния генератора, при первом обращении к нему заново вырабатывает ключ и начальное
+	заполнение из <b>/dev/urandom</b> (без повторного самотестирования), поэтому родительский
+	и дочерний процессы не выдают одинаковые последовательности.
+*/
+
+//==========================================================================//
+
+std::atomic<uint32> RandomGen::fork_generation(0);
+std::mutex RandomGen::init_mutex;
+RandomGenCounters RandomGen::moved_counters;
+
+// Контейнеры (std::vector) перемещают, а не копируют генераторы только при noexcept-перемещении.
+static_assert(std::is_nothrow_move_constructible<RandomGen>::value, "RandomGen move must be noexcept");
+
+//==========================================================================//
+
+/*! Текущее время в наносекундах для измерения задержек.
+*/
+static uint64 nowNs()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//==========================================================================//
+
+/*! Создаёт набор обнулённых счётчиков.
+*/
+RandomGenCounters::RandomGenCounters()
+{
+	for(uint32 i = 0; i < CounterCount; i++)
+	{
+		values[i].store(0, std::memory_order_relaxed);
+		reset_values[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+//==========================================================================//
+
+/*! Создаёт набор счётчиков путём копирования значений счётчиков \e c.
+	\param c - копируемые счётчики.
 */
+RandomGenCounters::RandomGenCounters(const RandomGenCounters &c)
+{
+	*this = c;
+}
 
 //==========================================================================//
 
-/*! Создаёт объект класса.
+/*! Учитывает длительность операции в гистограмме задержек.
+	\param _histogram - первый интервал гистограммы (\e RefillLatency или \e EntropyLatency).
+	\param _ns - длительность операции в наносекундах.
 */
-RandomGen::RandomGen() : cs(0xA5DC00007F6BLL), S(0), rand_seq(), curr_pos(sizeof(rand_seq)), cr(), initialized(false)
+void RandomGenCounters::addLatency(Counter _histogram, uint64 _ns)
 {
-	memset(rand_seq, 0, sizeof(rand_seq));
+	uint32 bucket = 63 - __builtin_clzll(_ns | 1);
+	if(bucket >= latencyBuckets)
+		bucket = latencyBuckets - 1;
+	add((Counter)(_histogram + bucket));
+}
+
+//==========================================================================//
+
+/*! Заполняет \e _stats текущими значениями счётчиков.
+	\param _stats - результат.
+*/
+void RandomGenCounters::get(RandomGenStats &_stats) const
+{
+	_stats.refills = value(Refills);
+	_stats.test1_failures = value(Test1Failures);
+	_stats.test2_failures = value(Test2Failures);
+	_stats.test3_failures = value(Test3Failures);
+	_stats.s_retries = value(SRetries);
+	_stats.fork_reseeds = value(ForkReseeds);
+	_stats.entropy_reads = value(EntropyReads);
+	_stats.entropy_bytes = value(EntropyBytes);
+	_stats.bytes_served = value(BytesServed);
+	for(uint32 i = 0; i < latencyBuckets; i++)
+	{
+		_stats.refill_latency[i] = value(RefillLatency + i);
+		_stats.entropy_latency[i] = value(EntropyLatency + i);
+	}
+}
+
+//==========================================================================//
+
+/*! Обнуляет все счётчики: запоминает их текущие значения как начало отсчёта. Сами счётчики
+	изменяет только поток, использующий генератор, поэтому обнуление из другого потока
+	не теряется при одновременном увеличении.
+*/
+void RandomGenCounters::reset()
+{
+	for(uint32 i = 0; i < CounterCount; i++)
+		reset_values[i].store(values[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+//==========================================================================//
+
+/*! Копирует значения счётчиков \e c.
+	\param c - копируемые счётчики.
+*/
+RandomGenCounters &RandomGenCounters::operator=(const RandomGenCounters &c)
+{
+	for(uint32 i = 0; i < CounterCount; i++)
+	{
+		values[i].store(c.values[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		reset_values[i].store(c.reset_values[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	return *this;
+}
+
+//==========================================================================//
+
+/*! Создаёт объект класса. Размер последовательности \e rand_seq округляется вверх до
+	кратного \e fipsBlockSize.
+	\param _seq_size - размер последовательности для выработки случайных чисел в байтах.
+	\param _test_windows - количество окон размером \e fipsBlockSize, проверяемых при каждом
+	обновлении последовательности. Окна выбираются равномерно по последовательности со сдвигом
+	при каждом обновлении, так что со временем проверяются все окна. Если \b 0 или больше
+	количества окон, проверяются все окна.
+*/
+RandomGen::RandomGen(uint32 _seq_size, uint32 _test_windows) : cs(0xA5DC00007F6BLL), S(0),
+	seq_size(_seq_size ? (_seq_size + fipsBlockSize - 1) / fipsBlockSize * fipsBlockSize : fipsBlockSize),
+	test_windows(_test_windows), test_phase(0), curr_pos(seq_size), cr(), initialized(false), deterministic(false), seed_state(0), counters(new RandomGenCounters()),
+	fork_gen(fork_generation.load(std::memory_order_relaxed))
+{
+	rand_seq = new uint8[seq_size];
+	memset(rand_seq, 0, seq_size);
 }
 
 //==========================================================================//
@@ -32,9 +179,37 @@ RandomGen::RandomGen() : cs(0xA5DC00007F6BLL), S(0), rand_seq(), curr_pos(sizeof
 /*! Создаёт объект класса путём копирования свойств объекта \e rg.
 	\param rg - объкт класса \e RandomGen.
 */
-RandomGen::RandomGen(const RandomGen &rg) : cs(rg.cs), S(rg.S), curr_pos(rg.curr_pos), cr(rg.cr), initialized(rg.initialized)
+RandomGen::RandomGen(const RandomGen &rg) : cs(rg.cs), S(rg.S), rand_seq(NULL), seq_size(rg.seq_size), test_windows(rg.test_windows),
+	test_phase(rg.test_phase), curr_pos(rg.curr_pos), cr(rg.cr), initialized(rg.initialized),
+	deterministic(rg.deterministic), seed_state(rg.seed_state), counters(new RandomGenCounters(*rg.counters)),
+	fork_gen(rg.fork_gen)
+{
+	if(rg.rand_seq)
+	{
+		rand_seq = new uint8[seq_size];
+		memcpy(rand_seq, rg.rand_seq, seq_size);
+	}
+}
+
+//==========================================================================//
+
+/*! Создаёт объект класса путём перемещения свойств объекта \e rg. Последовательность
+	\e rand_seq и счётчики статистики не копируются, а передаются новому объекту. Объект \e rg после
+	перемещения не инициализирован и перед использованием должен быть инициализирован заново методом
+	<em>init()</em>; до этого его статистика ведётся в общих счётчиках \e moved_counters.
+	\param rg - объкт класса \e RandomGen.
+*/
+RandomGen::RandomGen(RandomGen &&rg) noexcept : cs(rg.cs), S(rg.S), rand_seq(rg.rand_seq), seq_size(rg.seq_size), test_windows(rg.test_windows),
+	test_phase(rg.test_phase), curr_pos(rg.curr_pos), cr(rg.cr), initialized(rg.initialized),
+	deterministic(rg.deterministic), seed_state(rg.seed_state), counters(rg.counters),
+	fork_gen(rg.fork_gen)
 {
-	memcpy(rand_seq, rg.rand_seq, sizeof(rand_seq));
+	rg.counters = &moved_counters;
+	rg.rand_seq = NULL;
+	rg.S = 0;
+	rg.curr_pos = rg.seq_size;
+	rg.initialized = false;
+	rg.deterministic = false;
 }
 
 //==========================================================================//
@@ -43,6 +218,10 @@ RandomGen::RandomGen(const RandomGen &rg) : cs(rg.cs), S(rg.S), curr_pos(rg.curr
 */
 RandomGen::~RandomGen()
 {
+	delete [] rand_seq;
+	rand_seq = NULL;
+	if(counters != &moved_counters)
+		delete counters;
 }
 
 //==========================================================================//
@@ -57,17 +236,15 @@ RandomGen::~RandomGen()
 	заполнения генерируются с помощью генератора псевдослучайных чисел (функция random()).
 	Затем псевдослучайным образом заполняется массив, который будет шифроваться для получения
 	последовательности случайных величин.
+	\par
+	Инициализация разных объектов выполняется по очереди (под блокировкой \e init_mutex), так как
+	контрольная сумма зависит от глобального состояния функции <em>random()</em>. Поэтому объекты
+	можно инициализировать одновременно из разных потоков.
 */
 void RandomGen::init()
 {
-	// Инициализация криптографического модуля с фиксированным заполнением для проверки КС.
-	cr.init(false);
-	// Проверка контрольной суммы алгоритма.
-	if(cs != checkSum())
-	{
-		fprintf(stderr, "Check sum error\n");
-		exit(1);
-	}
+	std::lock_guard<std::mutex> lock(init_mutex);
+	selfTest();
 	// Инициализация криптографического модуля.
 	cr.init();
 	FILE *urand_file = fopen("/dev/urandom", "r");
@@ -83,12 +260,16 @@ void RandomGen::init()
 	{
 		uint32 n1 = random();
 		uint32 n2 = 0;
+		uint64 start = nowNs();
 		if(fread(&n2, sizeof(n2), 1, urand_file) < 1)
 		{
 			fprintf(stderr, "/dev/urandom fread error: %s\n", strerror(errno));
 			fclose(urand_file);
 			exit(1);
 		}
+		counters->add(RandomGenCounters::EntropyReads);
+		counters->add(RandomGenCounters::EntropyBytes, sizeof(n2));
+		counters->addLatency(RandomGenCounters::EntropyLatency, nowNs() - start);
 		S = n1 | ((uint64)n2 << (sizeof(uint32) * byteSize));
 		cr.simpleReplace((uint8*)&S, sizeof(S), true);
 	}
@@ -100,15 +281,63 @@ void RandomGen::init()
 
 //==========================================================================//
 
+/*! Инициализирует датчик в детерминированном режиме. После проверки контрольной суммы
+	алгоритма ключ, таблица замен, начальное заполнение \e S и все шифруемые последовательности
+	вырабатываются из \e _seed, а не из <b>/dev/urandom</b>, <em>random()</em> и текущего времени.
+	Поэтому при одинаковом \e _seed датчик выдаёт одинаковые последовательности и выполняет
+	одинаковое количество повторов проверок качества, что позволяет воспроизводить тесты
+	и измерения производительности.
+	\warning Последовательность полностью определяется значением \e _seed, поэтому данный режим
+	<b>нельзя использовать в рабочих системах</b>. Повторный вызов <em>init()</em> возвращает датчик
+	в обычный режим.
+	\param _seed - начальное значение.
+*/
+void RandomGen::initDeterministic(uint64 _seed)
+{
+	std::lock_guard<std::mutex> lock(init_mutex);
+	selfTest();
+	deterministic = true;
+	seed_state = _seed;
+
+	// Заполнение ключа и таблицы замен.
+	uint32 key[8];
+	uint8 replace_table[8][16];
+	uint8 *rows[8];
+	for(uint8 i = 0; i < 8; i++)
+	{
+		key[i] = nextSeeded();
+		for(uint8 j = 0; j < 16; j++)
+			replace_table[i][j] = nextSeeded() & 0xf;
+		rows[i] = replace_table[i];
+	}
+	cr.setKey(key);
+	cr.setReplaceTable(rows);
+
+	// Инициализация начального заполнения.
+	do
+	{
+		S = nextSeeded();
+		cr.simpleReplace((uint8*)&S, sizeof(S), true);
+	}
+	while(!isCurrentS());
+	initialized = true;
+	createNewRandSequence();
+}
+
+//==========================================================================//
+
 /*! Генерация 8-битного целого числа.
 	\returns 8-битное случайное число.
 */
 uint8 RandomGen::nextInt8()
 {
-	if(curr_pos == sizeof(rand_seq))
+	if(forked())
+		reseed();
+	if(curr_pos == seq_size)
 		createNewRandSequence();
 	uint8 res = rand_seq[curr_pos];
 	curr_pos++;
+	counters->add(RandomGenCounters::BytesServed);
 	return res;
 }
 
@@ -140,34 +369,324 @@ uint64 RandomGen::nextInt64()
 
 //==========================================================================//
 
+/*! Заполняет массив \e _data случайными байтами. Данные копируются из последовательности
+	\e rand_seq целыми фрагментами, поэтому метод предпочтителен для выработки больших объёмов.
+	Результат совпадает с последовательными вызовами <em>nextInt8()</em>.
+	\param _data - заполняемый массив.
+	\param _size - размер \e _data в байтах.
+*/
+void RandomGen::nextBytes(uint8 *_data, uint32 _size)
+{
+	counters->add(RandomGenCounters::BytesServed, _size);
+	if(forked())
+		reseed();
+	while(_size)
+	{
+		if(curr_pos == seq_size)
+			createNewRandSequence();
+		uint32 n = seq_size - curr_pos < _size ? seq_size - curr_pos : _size;
+		memcpy(_data, &rand_seq[curr_pos], n);
+		curr_pos += n;
+		_data += n;
+		_size -= n;
+	}
+}
+
+//==========================================================================//
+
+/*! Генерация равномерно распределённого целого числа из диапазона [0, \e _bound) без смещения,
+	свойственного выражению <em>nextInt32() % _bound</em>. Используется умножение 32-битного
+	случайного числа на \e _bound с редким отбрасыванием (метод Лемира).
+	Для выработки большого количества таких чисел предпочтителен класс \e BoundedRandom.
+	\param _bound - верхняя граница (не включается), больше \b 0.
+	\returns Случайное число из [0, \e _bound).
+*/
+uint32 RandomGen::nextBounded(uint32 _bound)
+{
+	uint64 m = (uint64)nextInt32() * _bound;
+	uint32 l = m;
+	if(l < _bound)
+	{
+		uint32 t = -_bound % _bound;
+		while(l < t)
+		{
+			m = (uint64)nextInt32() * _bound;
+			l = m;
+		}
+	}
+	return m >> 32;
+}
+
+//==========================================================================//
+
+/*! Освобождает последовательность \e rand_seq, чтобы простаивающий генератор хранил
+	только ключ и синхропосылку. Неиспользованный остаток последовательности отбрасывается.
+	При следующем обращении к генератору память выделяется заново и вырабатывается
+	новая последовательность.
+*/
+void RandomGen::compact()
+{
+	delete [] rand_seq;
+	rand_seq = NULL;
+	curr_pos = seq_size;
+}
+
+//==========================================================================//
+
+/*! Получение статистики работы генератора. Метод можно вызывать из любого потока
+	одновременно с использованием генератора.
+	\param _stats - результат.
+*/
+void RandomGen::getStats(RandomGenStats &_stats) const
+{
+	counters->get(_stats);
+}
+
+//==========================================================================//
+
+/*! Обнуление статистики работы генератора. Метод, как и <em>getStats()</em>, можно вызывать
+	из любого потока одновременно с использованием генератора.
+*/
+void RandomGen::resetStats()
+{
+	counters->reset();
+}
+
+//==========================================================================//
+
 /*! Копирует свойства объекта \e rg.
 	\param rg - объект класса \e RandomGen.
 */
 RandomGen &RandomGen::operator=(const RandomGen &rg)
 {
+	if(this == &rg)
+		return *this;
+	if(seq_size != rg.seq_size || !rg.rand_seq)
+	{
+		delete [] rand_seq;
+		rand_seq = NULL;
+		seq_size = rg.seq_size;
+	}
+	if(rg.rand_seq)
+	{
+		if(!rand_seq)
+			rand_seq = new uint8[seq_size];
+		memcpy(rand_seq, rg.rand_seq, seq_size);
+	}
+	cs = rg.cs;
+	S = rg.S;
+	test_windows = rg.test_windows;
+	test_phase = rg.test_phase;
+	curr_pos = rg.curr_pos;
+	cr = rg.cr;
+	initialized = rg.initialized;
+	deterministic = rg.deterministic;
+	seed_state = rg.seed_state;
+	if(counters == &moved_counters)
+		counters = new RandomGenCounters(*rg.counters);
+	else
+		*counters = *rg.counters;
+	fork_gen = rg.fork_gen;
+	return *this;
+}
+
+//==========================================================================//
+
+/*! Перемещает свойства объекта \e rg. Последовательность \e rand_seq передаётся без копирования,
+	счётчики статистики объектов меняются местами. Объект \e rg после перемещения должен быть
+	инициализирован заново методом <em>init()</em>.
+	\param rg - объект класса \e RandomGen.
+*/
+RandomGen &RandomGen::operator=(RandomGen &&rg) noexcept
+{
+	if(this == &rg)
+		return *this;
+	delete [] rand_seq;
+	rand_seq = rg.rand_seq;
+	seq_size = rg.seq_size;
 	cs = rg.cs;
 	S = rg.S;
-	memcpy(rand_seq, rg.rand_seq, sizeof(rand_seq));
+	test_windows = rg.test_windows;
+	test_phase = rg.test_phase;
 	curr_pos = rg.curr_pos;
 	cr = rg.cr;
 	initialized = rg.initialized;
+	deterministic = rg.deterministic;
+	seed_state = rg.seed_state;
+	std::swap(counters, rg.counters);
+	fork_gen = rg.fork_gen;
+	rg.rand_seq = NULL;
+	rg.S = 0;
+	rg.curr_pos = rg.seq_size;
+	rg.initialized = false;
+	rg.deterministic = false;
 	return *this;
 }
 
 //==========================================================================//
 
-/*! Вычисление контрольной суммы алгоритма.
+/*! Самотестирование алгоритма. Криптографический модуль инициализируется фиксированным
+	заполнением, после чего вычисляется контрольная сумма алгоритма и сравнивается
+	с эталонной. В случае несовпадения КС производится выход из приложения.
+*/
+void RandomGen::selfTest()
+{
+	registerForkHandler();
+	if(counters == &moved_counters)
+		counters = new RandomGenCounters();
+	fork_gen = fork_generation.load(std::memory_order_relaxed);
+	initialized = false;
+	deterministic = false;
+	// Инициализация криптографического модуля с фиксированным заполнением для проверки КС.
+	cr.init(false);
+	// Проверка контрольной суммы алгоритма.
+	if(cs != checkSum())
+	{
+		fprintf(stderr, "Check sum error\n");
+		exit(1);
+	}
+}
+
+//==========================================================================//
+
+/*! Быстрая повторная инициализация генератора в дочернем процессе после <em>fork()</em>.
+	Ключ и начальное заполнение \e S вырабатываются заново из <b>/dev/urandom</b>, таблица замен
+	сохраняется, самотестирование не выполняется. Неиспользованный остаток последовательности
+	\e rand_seq отбрасывается. Детерминированный режим при этом отключается.
+*/
+void RandomGen::reseed()
+{
+	fork_gen = fork_generation.load(std::memory_order_relaxed);
+	if(!initialized)
+		return;
+	FILE *urand_file = fopen("/dev/urandom", "r");
+	if(!urand_file)
+	{
+		fprintf(stderr, "/dev/urandom fopen error: %s\n", strerror(errno));
+		exit(1);
+	}
+	deterministic = false;
+	uint32 key[8];
+	fillSource((uint8*)key, sizeof(key), urand_file);
+	cr.setKey(key);
+	memset(key, 0, sizeof(key));
+	do
+		fillSource((uint8*)&S, sizeof(S), urand_file);
+	while(!isCurrentS());
+	fclose(urand_file);
+	curr_pos = seq_size;
+	counters->add(RandomGenCounters::ForkReseeds);
+}
+
+//==========================================================================//
+
+/*! Вырабатывает новые ключ, таблицу замен и начальное заполнение \e S из <b>/dev/urandom</b>
+	без самотестирования (самотестирование должно быть выполнено ранее методом <em>init()</em>).
+	Используется пулом \e RandomGenPool, чтобы состояния всех слотов были независимы.
+	Неиспользованный остаток последовательности \e rand_seq отбрасывается.
+*/
+void RandomGen::rekey()
+{
+	FILE *urand_file = fopen("/dev/urandom", "r");
+	if(!urand_file)
+	{
+		fprintf(stderr, "/dev/urandom fopen error: %s\n", strerror(errno));
+		exit(1);
+	}
+	fork_gen = fork_generation.load(std::memory_order_relaxed);
+	initialized = true;
+	deterministic = false;
+	uint32 key[8];
+	uint8 replace_table[8][16];
+	uint8 *rows[8];
+	fillSource((uint8*)key, sizeof(key), urand_file);
+	fillSource((uint8*)replace_table, sizeof(replace_table), urand_file);
+	for(uint8 i = 0; i < 8; i++)
+	{
+		for(uint8 j = 0; j < 16; j++)
+			replace_table[i][j] &= 0xf;
+		rows[i] = replace_table[i];
+	}
+	cr.setKey(key);
+	cr.setReplaceTable(rows);
+	memset(key, 0, sizeof(key));
+	memset(replace_table, 0, sizeof(replace_table));
+	do
+		fillSource((uint8*)&S, sizeof(S), urand_file);
+	while(!isCurrentS());
+	fclose(urand_file);
+	curr_pos = seq_size;
+}
+
+//==========================================================================//
+
+/*! Обнуляет ключ, таблицу замен, начальное заполнение \e S и последовательность \e rand_seq
+	и освобождает её. После вызова генератор не инициализирован.
+*/
+void RandomGen::wipe()
+{
+	uint32 key[8];
+	uint8 replace_table[8][16];
+	uint8 *rows[8];
+	memset(key, 0, sizeof(key));
+	memset(replace_table, 0, sizeof(replace_table));
+	for(uint8 i = 0; i < 8; i++)
+		rows[i] = replace_table[i];
+	cr.setKey(key);
+	cr.setReplaceTable(rows);
+	S = 0;
+	if(rand_seq)
+	{
+		memset(rand_seq, 0, seq_size);
+		// Обнуление памяти перед освобождением не должно удаляться компилятором.
+		__asm__ __volatile__("" : : "r"(rand_seq) : "memory");
+	}
+	compact();
+	initialized = false;
+	deterministic = false;
+}
+
+//==========================================================================//
+
+/*! Однократная регистрация обработчика <em>fork()</em> с помощью <em>pthread_atfork()</em>.
+*/
+void RandomGen::registerForkHandler()
+{
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+	pthread_once(&once, []() { pthread_atfork(NULL, NULL, onFork); });
+}
+
+//==========================================================================//
+
+/*! Обработчик, вызываемый в дочернем процессе после <em>fork()</em>. Увеличивает счётчик
+	\e fork_generation, по которому генераторы обнаруживают факт порождения процесса.
+*/
+void RandomGen::onFork()
+{
+	fork_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+//==========================================================================//
+
+/*! Вычисление контрольной суммы алгоритма. Вычисление всегда производится над одним
+	блоком размером \e fipsBlockSize, независимо от размера последовательности \e rand_seq.
 	\returns Вычисленная контрольная сумма.
 */
 uint64 RandomGen::checkSum()
 {
+	if(!rand_seq)
+		rand_seq = new uint8[seq_size];
+	uint32 size = seq_size;
+	seq_size = fipsBlockSize;
+	test_phase = 0;
+	curr_pos = seq_size;
 	S = 10781;
-	for(uint32 i = 0; i < sizeof(rand_seq); i += sizeof(uint32))
+	for(uint32 i = 0; i < seq_size; i += sizeof(uint32))
 	{
 		uint32 tmp = random();
 		memcpy(&rand_seq[i], &tmp, sizeof(tmp));
 	}
-	cr.gammingWF(rand_seq, sizeof(rand_seq), S, true);
+	cr.gammingWF(rand_seq, seq_size, S, true);
 	uint32 n = 100;
 	uint32 S0 = 0, S1 = 0;
 	for(uint32 i = 0; i < n; i++)
@@ -178,11 +697,27 @@ uint64 RandomGen::checkSum()
 	uint32 Z0 = S0;
 	uint32 Z1 = 65535 - S1;
 	uint64 Z = Z0 | (uint64)Z1 << 32;
+	seq_size = size;
+	curr_pos = seq_size;
 	return Z;
 }
 
 //==========================================================================//
 
+/*! Выработка очередного значения исходных данных детерминированного режима
+	(алгоритм SplitMix64).
+	\returns 64-битное значение, полностью определяемое начальным значением \e seed_state.
+*/
+uint64 RandomGen::nextSeeded()
+{
+	uint64 z = (seed_state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+//==========================================================================//
+
 /*! Проверка корректности начального заполнения \e S.
 	\returns \b true - если \e S удовлетворяет требованиям, \b false - иначе.
 */
@@ -196,7 +731,10 @@ bool RandomGen::isCurrentS() const
 	float bound = S_bits_size * 0.12;
 	uint8 diff = zero - (S_bits_size - zero);
 	if(diff >= bound || diff <= -bound)
+	{
+		counters->add(RandomGenCounters::SRetries);
 		return false;
+	}
 	return true;
 }
 
@@ -204,70 +742,130 @@ bool RandomGen::isCurrentS() const
 
 /*! Создание последовательности для выработки случайных чисел. Создание производится
 	путём шифрования \e rand_seq по алгоритму гаммирования с обратной связью. При
-	этом проверяется качество полученной последовательности. Если результат не удовлетворяет
-	требованиям, операция повторяется. При получении "качественной" последовательности
+	этом проверяется качество окон полученной последовательности. Если окно не удовлетворяет
+	требованиям, оно создаётся заново. При получении "качественной" последовательности
 	иекущая позиция \e curr_pos сбрасывается в \b 0.
 */
 void RandomGen::createNewRandSequence()
 {
-	FILE *urand_file = fopen("/dev/urandom", "r");
-	if(!urand_file)
+	FILE *urand_file = deterministic ? NULL : fopen("/dev/urandom", "r");
+	if(!urand_file && !deterministic)
 	{
 		fprintf(stderr, "/dev/urandom fopen error: %s\n", strerror(errno));
-		fclose(urand_file);
 		exit(1);
 	}
-	uint32 tmp;
-	do
+	if(!rand_seq)
+		rand_seq = new uint8[seq_size];
+	uint64 start = nowNs();
+	// Создание шифруемой последовательности.
+	fillSource(rand_seq, seq_size, urand_file);
+	cr.gammingWF(rand_seq, seq_size, S, true);
+
+	// Проверка выбранных окон последовательности.
+	uint32 windows = seq_size / fipsBlockSize;
+	uint32 count = (test_windows == 0 || test_windows > windows) ? windows : test_windows;
+	for(uint32 k = 0; k < count; k++)
 	{
-		// Создание шифруемой последовательности.
-		for(uint32 i = 0; i < sizeof(rand_seq); i += sizeof(uint32))
+		uint8 *window = &rand_seq[(test_phase + (uint64)k * windows / count) % windows * fipsBlockSize];
+		while(!isCurrentSeq(window))
 		{
-			if(!initialized)
-				tmp = random();
-			else if(fread(&tmp, sizeof(tmp), 1, urand_file) < 1)
-			{
-				fprintf(stderr, "/dev/urandom fread error: %s\n", strerror(errno));
-				fclose(urand_file);
-				exit(1);
-			}
+			fillSource(window, fipsBlockSize, urand_file);
+			cr.gammingWF(window, fipsBlockSize, S, true);
+		}
+	}
+	test_phase = (test_phase + 1) % windows;
+	if(urand_file)
+		fclose(urand_file);
+	curr_pos = 0;
+	counters->add(RandomGenCounters::Refills);
+	counters->addLatency(RandomGenCounters::RefillLatency, nowNs() - start);
+}
+
+//==========================================================================//
 
-			memcpy(&rand_seq[i], &tmp, sizeof(tmp));
+/*! Заполнение шифруемой последовательности. До завершения инициализации данные
+	вырабатываются функцией <em>random()</em>, после - читаются из файла <b>/dev/urandom</b>.
+	В детерминированном режиме данные вырабатываются из начального значения.
+	\param _data - заполняемый массив.
+	\param _size - размер \e _data в байтах, кратный 4.
+	\param _urand_file - открытый файл <b>/dev/urandom</b> (\b NULL в детерминированном режиме).
+*/
+void RandomGen::fillSource(uint8 *_data, uint32 _size, FILE *_urand_file)
+{
+	if(initialized && deterministic)
+	{
+		for(uint32 i = 0; i < _size; i += sizeof(uint32))
+		{
+			uint32 tmp = nextSeeded();
+			memcpy(&_data[i], &tmp, sizeof(tmp));
 		}
-		cr.gammingWF(rand_seq, sizeof(rand_seq), S, true);
+		return;
+	}
+	if(initialized)
+	{
+		uint64 start = nowNs();
+		if(fread(_data, _size, 1, _urand_file) < 1)
+		{
+			fprintf(stderr, "/dev/urandom fread error: %s\n", strerror(errno));
+			fclose(_urand_file);
+			exit(1);
+		}
+		counters->add(RandomGenCounters::EntropyReads);
+		counters->add(RandomGenCounters::EntropyBytes, _size);
+		counters->addLatency(RandomGenCounters::EntropyLatency, nowNs() - start);
+		return;
+	}
+	for(uint32 i = 0; i < _size; i += sizeof(uint32))
+	{
+		uint32 tmp = random();
+		memcpy(&_data[i], &tmp, sizeof(tmp));
 	}
-	while(!isCurrentSeq());
-	fclose(urand_file);
-	curr_pos = 0;	
 }
 
 //==========================================================================//
 
-/*! Проверка качества текущей последовательности \e rand_seq путём последовательного тестирования
+/*! Проверка качества окна текущей последовательности \e rand_seq путём последовательного тестирования
 	на частоту битов (<em>test1()</em>), частоту четырёхбитовых последовательностей (<em>test2()</em>)
 	и частоту битовых (<em>test3()</em>) серий.
+	\param _window - начало проверяемого окна размером \e fipsBlockSize.
 	\returns \b true - в случае успеха, \b false - иначе.
 */
-bool RandomGen::isCurrentSeq() const
+bool RandomGen::isCurrentSeq(const uint8 *_window) const
 {
-	return (test1() && test2() && test3());
+	if(!test1(_window))
+	{
+		counters->add(RandomGenCounters::Test1Failures);
+		return false;
+	}
+	if(!test2(_window))
+	{
+		counters->add(RandomGenCounters::Test2Failures);
+		return false;
+	}
+	if(!test3(_window))
+	{
+		counters->add(RandomGenCounters::Test3Failures);
+		return false;
+	}
+	return true;
 }
 
 //==========================================================================//
 
-/*! Проверка текущей последовательности \e rand_seq на частоту битов.
+/*! Проверка окна текущей последовательности \e rand_seq на частоту битов.
+	\param _window - начало проверяемого окна размером \e fipsBlockSize.
 	\returns \b true - в случае успеха, \b false - иначе.
 */
-bool RandomGen::test1() const
+bool RandomGen::test1(const uint8 *_window) const
 {
 // 	qDebug() << "Проверка частоты битов...";
 	uint32 begin_min_count = 9725;
 	uint32 begin_max_count = 10275;
-	uint32 seq_bits_size = sizeof(rand_seq) * byteSize;
+	uint32 seq_bits_size = fipsBlockSize * byteSize;
 	uint32 zero = 0;
 
 	for(uint32 i = 0; i < seq_bits_size; i++)
-		if(rand_seq[i / byteSize] & (1 << (i % byteSize)))
+		if(_window[i / byteSize] & (1 << (i % byteSize)))
 			zero++;
 	bool res = false;
 	if(zero >= begin_min_count && zero <= begin_max_count)
@@ -277,10 +875,11 @@ bool RandomGen::test1() const
 
 //==========================================================================//
 
-/*! Проверка текущей последовательности \e rand_seq на частоту четырёхбитовых последовательностей.
+/*! Проверка окна текущей последовательности \e rand_seq на частоту четырёхбитовых последовательностей.
+	\param _window - начало проверяемого окна размером \e fipsBlockSize.
 	\returns \b true - в случае успеха, \b false - иначе.
 */
-bool RandomGen::test2() const
+bool RandomGen::test2(const uint8 *_window) const
 {
 // 	qDebug() << "Проверка частоты четырёхбитовых последовательностей...";
 	float min_bound = 2.16;
@@ -288,7 +887,7 @@ bool RandomGen::test2() const
 	float X = 0;
 	bool s[4] = {false};
 	uint32 n_sum = 0;
-	uint32 seq_bits_size = sizeof(rand_seq) * byteSize;
+	uint32 seq_bits_size = fipsBlockSize * byteSize;
 	for(uint32 i = 0; i < 16; i++)
 	{
 		s[0] = i & 1;
@@ -298,10 +897,10 @@ bool RandomGen::test2() const
 		uint32 n = 0;
 		for(uint32 j = 0; j < seq_bits_size; j += 4)
 		{
-			bool bit0 = rand_seq[j / byteSize] & (1 << (j % byteSize));
-			bool bit1 = rand_seq[(j + 1) / byteSize] & (1 << ((j + 1) % byteSize));
-			bool bit2 = rand_seq[(j + 2) / byteSize] & (1 << ((j + 2) % byteSize));
-			bool bit3 = rand_seq[(j + 3) / byteSize] & (1 << ((j + 3) % byteSize));
+			bool bit0 = _window[j / byteSize] & (1 << (j % byteSize));
+			bool bit1 = _window[(j + 1) / byteSize] & (1 << ((j + 1) % byteSize));
+			bool bit2 = _window[(j + 2) / byteSize] & (1 << ((j + 2) % byteSize));
+			bool bit3 = _window[(j + 3) / byteSize] & (1 << ((j + 3) % byteSize));
 
 			if(bit0 == s[0] && bit1 == s[1] && bit2 == s[2] && bit3 == s[3])
 				n++;
@@ -317,15 +916,16 @@ bool RandomGen::test2() const
 
 //==========================================================================//
 
-/*! Проверка текущей последовательности \e rand_seq на частоту битовых серий.
+/*! Проверка окна текущей последовательности \e rand_seq на частоту битовых серий.
+	\param _window - начало проверяемого окна размером \e fipsBlockSize.
 	\returns \b true - в случае успеха, \b false - иначе.
 */
-bool RandomGen::test3() const
+bool RandomGen::test3(const uint8 *_window) const
 {
 // 	qDebug() << "Проверка частоты битовых серий...";
 	uint32 min_bounds[6] = {2343, 1135, 542, 251, 111, 111};
 	uint32 max_bounds[6] = {2657, 1365, 708, 373, 201, 201};
-	uint32 seq_bits_size = sizeof(rand_seq) * byteSize;
+	uint32 seq_bits_size = fipsBlockSize * byteSize;
 	for(uint32 n = 0; n < 6; n++)
 	{
 		uint32 count0 = 0;
@@ -337,8 +937,8 @@ bool RandomGen::test3() const
 			bool biti_1;
 			do
 			{
-				biti = rand_seq[i / byteSize] & (1 << (i % byteSize));
-				biti_1 = rand_seq[(i - 1) / byteSize] & (1 << ((i - 1) % byteSize));
+				biti = _window[i / byteSize] & (1 << (i % byteSize));
+				biti_1 = _window[(i - 1) / byteSize] & (1 << ((i - 1) % byteSize));
 				bit_count++;
 				i++;
 			}
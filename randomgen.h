@@ -2,42 +2,154 @@
 #ifndef _RANDOMGEN_H_
 #define _RANDOMGEN_H_
 
+#include <stdio.h>
+
+#include <atomic>
+#include <mutex>
+
 #include "cryptographer.h"
 
+const uint32 fipsBlockSize = 2500;	//!< Размер блока для тестов FIPS 140-1 (20000 бит) в байтах.
+const uint32 latencyBuckets = 32;	//!< Количество интервалов гистограмм задержек.
+
+//==========================================================================//
+
+//! Статистика работы генератора случайных чисел.
+/*! Интервал \e i гистограммы задержек содержит количество операций длительностью
+	от \f$ 2^i \f$ до \f$ 2^{i+1} \f$ наносекунд (последний интервал - все более длительные).
+*/
+struct RandomGenStats
+{
+	uint64 refills;							//!< Количество обновлений последовательности.
+	uint64 test1_failures;					//!< Количество отказов проверки частоты битов.
+	uint64 test2_failures;					//!< Количество отказов проверки частоты четырёхбитовых последовательностей.
+	uint64 test3_failures;					//!< Количество отказов проверки частоты битовых серий.
+	uint64 s_retries;						//!< Количество отказов проверки начального заполнения \e S.
+	uint64 fork_reseeds;					//!< Количество повторных инициализаций после <em>fork()</em>.
+	uint64 entropy_reads;					//!< Количество чтений <b>/dev/urandom</b>.
+	uint64 entropy_bytes;					//!< Количество байтов, прочитанных из <b>/dev/urandom</b>.
+	uint64 bytes_served;					//!< Количество выданных случайных байтов.
+	uint64 refill_latency[latencyBuckets];	//!< Гистограмма длительности обновления последовательности.
+	uint64 entropy_latency[latencyBuckets];	//!< Гистограмма длительности чтения <b>/dev/urandom</b>.
+};
+
+//==========================================================================//
+
+//! Счётчики статистики работы генератора случайных чисел.
+/*! Счётчики изменяются только потоком, использующим генератор, поэтому увеличение
+	выполняется простыми чтением и записью без блокировок, а другие потоки могут в любой
+	момент прочитать согласованные значения отдельных счётчиков. Обнуление не изменяет
+	сами счётчики, а запоминает их текущие значения, которые затем вычитаются при чтении,
+	поэтому обнулять счётчики тоже можно из любого потока.
+*/
+class RandomGenCounters
+{
+public:
+	//! Номера счётчиков.
+	enum Counter
+	{
+		Refills, Test1Failures, Test2Failures, Test3Failures, SRetries, ForkReseeds,
+		EntropyReads, EntropyBytes, BytesServed,
+		RefillLatency,										//!< Первый интервал гистограммы обновлений.
+		EntropyLatency = RefillLatency + latencyBuckets,	//!< Первый интервал гистограммы чтений.
+		CounterCount = EntropyLatency + latencyBuckets		//!< Количество счётчиков.
+	};
+
+private:
+	std::atomic<uint64> values[CounterCount];		//!< Значения счётчиков.
+	std::atomic<uint64> reset_values[CounterCount];	//!< Значения счётчиков на момент последнего обнуления.
+
+	//! Значение счётчика \e _counter после последнего обнуления.
+	uint64 value(uint32 _counter) const
+	{
+		return values[_counter].load(std::memory_order_relaxed) - reset_values[_counter].load(std::memory_order_relaxed);
+	}
+
+public:
+	RandomGenCounters();											//!< Конструктор.
+	RandomGenCounters(const RandomGenCounters &c);					//!< Конструктор копирования.
+
+	//! Увеличение счётчика \e _counter на \e _n.
+	void add(Counter _counter, uint64 _n = 1)
+	{
+		values[_counter].store(values[_counter].load(std::memory_order_relaxed) + _n, std::memory_order_relaxed);
+	}
+	void addLatency(Counter _histogram, uint64 _ns);				//!< Учёт длительности операции в гистограмме.
+	void get(RandomGenStats &_stats) const;							//!< Получение значений счётчиков.
+	void reset();													//!< Обнуление счётчиков.
+
+	RandomGenCounters &operator=(const RandomGenCounters &c);		//!< Оператор присваивания.
+};
+
 //==========================================================================//
 
 //! Класс генератора случайных чисел.
 class RandomGen
 {
+	friend class RandomGenPool;
+
 private:
 	uint64 cs;									//!< Контрольная сумма алгоритма.
 	uint64 S;									//!< Синхропосылка (начальное заполнение алгоритма).
-	uint8 rand_seq[2500];						//!< Последовательность для выработки случайных чисел.
+	uint8 *rand_seq;							//!< Последовательность для выработки случайных чисел.
+	uint32 seq_size;							//!< Размер последовательности \e rand_seq в байтах.
+	uint32 test_windows;						//!< Количество тестируемых окон \e rand_seq (0 - все окна).
+	uint32 test_phase;							//!< Номер первого тестируемого окна при очередном обновлении.
 	uint32 curr_pos;							//!< Текущая позиция в последовательности \e curr_seq.
 	Cryptographer cr;							//!< Объект, реализующий криптографические преобразования.
 	bool initialized;							//!< Флаг, устанавливаемый, если ПДСЧ успешно инициализирован.
+	bool deterministic;							//!< Флаг детерминированного режима (см. <em>initDeterministic()</em>).
+	uint64 seed_state;							//!< Состояние генератора исходных данных детерминированного режима.
+	RandomGenCounters *counters;				//!< Счётчики статистики работы (вне объекта, чтобы не копировать их при перемещении).
+	uint32 fork_gen;							//!< Значение \e fork_generation на момент инициализации.
+	static std::atomic<uint32> fork_generation;	//!< Счётчик вызовов <em>fork()</em> в дочерних процессах.
+	static std::mutex init_mutex;				//!< Блокировка инициализации (самотестирование использует глобальное состояние <em>random()</em>).
+	static RandomGenCounters moved_counters;	//!< Счётчики перемещённых объектов до их повторной инициализации.
 
 public:
-	RandomGen();								//!< Конструктор.
+	RandomGen(uint32 _seq_size = fipsBlockSize, uint32 _test_windows = 0);	//!< Конструктор.
 	RandomGen(const RandomGen &rg);				//!< Коструктор копирования.
+	RandomGen(RandomGen &&rg) noexcept;			//!< Коструктор перемещения.
 	~RandomGen();								//!< Деструктор.
 
 	void init();								//!< Инициализация.
+	void initDeterministic(uint64 _seed);		//!< Детерминированная инициализация (только для тестов).
 
 	uint8 nextInt8();							//!< Генезация 1-байтового целого числа.
 	uint32 nextInt32();							//!< Генерация 4-байтового целого числа.
 	uint64 nextInt64();							//!< Генерация 8-байтового целого числа.
+	void nextBytes(uint8 *_data, uint32 _size);	//!< Заполнение массива случайными байтами.
+	uint32 nextBounded(uint32 _bound);			//!< Генерация равномерного целого числа из [0, \e _bound).
+
+	void compact();								//!< Освобождение последовательности \e rand_seq на время простоя.
+
+	//! Проверка, был ли процесс порождён <em>fork()</em> после инициализации генератора.
+	bool forked() const { return fork_gen != fork_generation.load(std::memory_order_relaxed); }
+	//! Номер поколения процесса: увеличивается в дочернем процессе после каждого <em>fork()</em>.
+	static uint32 forkGeneration() { return fork_generation.load(std::memory_order_relaxed); }
+
+	void getStats(RandomGenStats &_stats) const;	//!< Получение статистики работы.
+	void resetStats();							//!< Обнуление статистики работы.
 
 	RandomGen &operator=(const RandomGen &rg);	//!< Оператор присваивания.
+	RandomGen &operator=(RandomGen &&rg) noexcept;	//!< Оператор перемещающего присваивания.
 
 private:
+	void selfTest();							//!< Самотестирование алгоритма.
+	void reseed();								//!< Быстрая повторная инициализация после <em>fork()</em>.
+	void rekey();								//!< Выработка нового ключа, таблицы замен и \e S.
+	void wipe();								//!< Уничтожение ключевой информации.
+	static void registerForkHandler();			//!< Регистрация обработчика <em>fork()</em>.
+	static void onFork();						//!< Обработчик <em>fork()</em> в дочернем процессе.
 	uint64 checkSum();							//!< Проверка контрольной суммы алгоритма.
+	uint64 nextSeeded();						//!< Очередное значение исходных данных детерминированного режима.
 	bool isCurrentS() const;					//!< Проверка коррекности начального заполнения \e S.
 	void createNewRandSequence();				//!< Создание новой последовательности \e curr_seq.
-	bool isCurrentSeq() const;					//!< Проверка коррекности текущей последовательности \e curr_seq.
-	bool test1() const;							//!< Проверка на частоту битов.
-	bool test2() const;							//!< Проверка частоты четырёхбитовых последовательностей.
-	bool test3() const;							//!< Проверка частоты битовых серий.
+	void fillSource(uint8 *_data, uint32 _size, FILE *_urand_file);	//!< Заполнение шифруемой последовательности.
+	bool isCurrentSeq(const uint8 *_window) const;	//!< Проверка коррекности окна текущей последовательности \e curr_seq.
+	bool test1(const uint8 *_window) const;		//!< Проверка на частоту битов.
+	bool test2(const uint8 *_window) const;		//!< Проверка частоты четырёхбитовых последовательностей.
+	bool test3(const uint8 *_window) const;		//!< Проверка частоты битовых серий.
 };
 
 //==========================================================================//
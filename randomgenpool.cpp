@@ -0,0 +1,423 @@
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <new>
+#include <string>
+
+#include "randomgenpool.h"
+
+/*! \class RandomGenPool
+	Пул готовых к использованию состояний генератора \e RandomGen, хранимый в отображаемом
+	в память файле. Родительский процесс создаёт пул и заполняет его слоты: каждый слот содержит
+	независимо выработанные из <b>/dev/urandom</b> ключ, таблицу замен и синхропосылку \e S
+	и уже проверенную последовательность \e rand_seq. Короткоживущие дочерние процессы вместо полной инициализации
+	<em>RandomGen::init()</em> открывают пул и атомарно захватывают по одному слоту. Захваченный слот
+	сразу же обнуляется и освобождается, поэтому разные процессы никогда не получают одинаковое
+	состояние. Родительский процесс периодически заполняет освободившиеся слоты методом <em>refill()</em>.
+	\par
+	Слот, оставшийся в состоянии заполнения или захвата после аварийного завершения процесса,
+	восстанавливается при очередном <em>refill()</em>: если процесс-владелец слота (его номер
+	хранится вместе с состоянием) больше не существует или состояние слота не меняется дольше
+	\e staleTimeoutNs. Все процессы, работающие с пулом, должны находиться в одном
+	пространстве имён PID.
+	\par
+	Файл пула создаётся с правами \b 0600 во временном файле рядом с \e _path и после заполнения
+	атомарно заменяет прежний файл (<em>rename()</em>), поэтому процессы, отобразившие прежний пул,
+	продолжают безопасно работать с ним. Отображение исключается из дампов памяти и по возможности
+	блокируется в оперативной памяти. Ключевая информация генератора, заполняющего слоты,
+	уничтожается после каждого заполнения.
+	\par Пример:
+	\code
+	// Родительский процесс.
+	RandomGenPool pool;
+	pool.create("/run/app/rng.pool", 64);
+	// ... по мере необходимости:
+	pool.refill();
+
+	// Дочерний процесс.
+	RandomGenPool pool;
+	RandomGen rg;
+	if(!pool.open("/run/app/rng.pool") || !pool.claim(rg))
+		rg.init();
+	uint32 n = rg.nextInt32();
+	\endcode
+*/
+
+//==========================================================================//
+
+const uint64 poolMagic = 0x4C4F4F504E545243ULL;	//!< Сигнатура файла пула.
+const uint32 poolVersion = 2;					//!< Версия формата файла пула.
+const uint32 poolAlign = 64;					//!< Выравнивание заголовка и слотов.
+const uint64 staleTimeoutNs = 10000000000ULL;	//!< Время, после которого неизменное заполнение или захват слота считается брошенным.
+
+//! Состояния слота пула.
+enum SlotState
+{
+	SlotEmpty = 0,		//!< Слот свободен.
+	SlotFilling = 1,	//!< Слот заполняется.
+	SlotReady = 2,		//!< Слот содержит готовое состояние.
+	SlotClaimed = 3		//!< Слот захвачен процессом.
+};
+
+//! Заголовок файла пула.
+struct PoolHeader
+{
+	uint64 magic;					//!< Сигнатура \e poolMagic.
+	uint32 version;					//!< Версия формата.
+	uint32 slot_count;				//!< Количество слотов.
+	uint32 seq_size;				//!< Размер последовательности \e rand_seq.
+	uint32 slot_size;				//!< Размер слота в байтах.
+	std::atomic<uint32> hint;		//!< Номер слота, с которого начинается поиск при захвате.
+};
+
+//! Заголовок слота пула, за которым следует последовательность \e rand_seq.
+struct SlotHeader
+{
+	std::atomic<uint64> state;		//!< Состояние слота (\e SlotState) в младших 32 битах, PID владельца - в старших.
+	uint32 key[8];					//!< Ключ.
+	uint8 replace_table[8][16];		//!< Таблица замен.
+	uint64 S;						//!< Синхропосылка.
+};
+
+/*! Округление \e n вверх до кратного \e poolAlign.
+*/
+static uint64 alignUp(uint64 n)
+{
+	return (n + poolAlign - 1) / poolAlign * poolAlign;
+}
+
+/*! Значение поля \e state слота.
+	\param _state - состояние (\e SlotState).
+	\param _owner - PID процесса-владельца (\b 0 для свободного и готового слота).
+*/
+static uint64 slotState(uint32 _state, uint32 _owner = 0)
+{
+	return _state | ((uint64)_owner << 32);
+}
+
+/*! Текущее время в наносекундах.
+*/
+static uint64 nowNs()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//==========================================================================//
+
+/*! Создаёт объект класса, не связанный с файлом пула.
+*/
+RandomGenPool::RandomGenPool() : fd(-1), map(NULL), map_size(0), rg(NULL)
+{
+}
+
+//==========================================================================//
+
+/*! Уничтожает объект класса. Файл пула при этом не удаляется.
+*/
+RandomGenPool::~RandomGenPool()
+{
+	close();
+}
+
+//==========================================================================//
+
+/*! Создаёт (или пересоздаёт) файл пула и заполняет все его слоты. Для заполнения
+	используется генератор, проходящий полную инициализацию <em>RandomGen::init()</em> один раз.
+	Пул создаётся во временном файле в том же каталоге, который после заполнения переименовывается
+	в \e _path; существующий файл пула не усекается.
+	\param _path - имя файла пула.
+	\param _slots - количество слотов.
+	\param _seq_size - размер последовательности \e rand_seq в каждом слоте.
+	\returns \b true в случае успеха, \b false - иначе (причина в \e errno).
+*/
+bool RandomGenPool::create(const char *_path, uint32 _slots, uint32 _seq_size)
+{
+	close();
+	if(!_slots)
+		return false;
+	rg = new RandomGen(_seq_size);
+	rg->init();
+	uint32 slot_size = alignUp(sizeof(SlotHeader) + rg->seq_size);
+	uint64 size = alignUp(sizeof(PoolHeader)) + (uint64)_slots * slot_size;
+
+	std::string tmp_path = std::string(_path) + ".XXXXXX";
+	fd = mkostemp(&tmp_path[0], O_CLOEXEC);
+	if(fd < 0 || fchmod(fd, 0600) < 0 || ftruncate(fd, size) < 0 || !mapFile(size))
+	{
+		int err = errno;
+		if(fd >= 0)
+			unlink(tmp_path.c_str());
+		close();
+		errno = err;
+		return false;
+	}
+	PoolHeader *header = (PoolHeader*)map;
+	header->version = poolVersion;
+	header->slot_count = _slots;
+	header->seq_size = rg->seq_size;
+	header->slot_size = slot_size;
+	new(&header->hint) std::atomic<uint32>(0);
+	for(uint32 i = 0; i < _slots; i++)
+		new(&((SlotHeader*)slot(i))->state) std::atomic<uint64>(slotState(SlotEmpty));
+	__atomic_store_n(&header->magic, poolMagic, __ATOMIC_RELEASE);
+	refill();
+	if(rename(tmp_path.c_str(), _path) < 0)
+	{
+		int err = errno;
+		unlink(tmp_path.c_str());
+		close();
+		errno = err;
+		return false;
+	}
+	return true;
+}
+
+//==========================================================================//
+
+/*! Открывает существующий файл пула.
+	\param _path - имя файла пула.
+	\returns \b true в случае успеха, \b false - если файл недоступен или повреждён.
+*/
+bool RandomGenPool::open(const char *_path)
+{
+	close();
+	fd = ::open(_path, O_RDWR | O_CLOEXEC);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) < 0 || (uint64)st.st_size < alignUp(sizeof(PoolHeader)) || !mapFile(st.st_size))
+	{
+		close();
+		return false;
+	}
+	const PoolHeader *header = (const PoolHeader*)map;
+	if(__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != poolMagic || header->version != poolVersion ||
+		!header->slot_count || !header->seq_size || header->seq_size % fipsBlockSize ||
+		header->slot_size < sizeof(SlotHeader) + header->seq_size ||
+		alignUp(sizeof(PoolHeader)) + (uint64)header->slot_count * header->slot_size > map_size)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+//==========================================================================//
+
+/*! Закрывает пул: снимает отображение файла и закрывает его.
+*/
+void RandomGenPool::close()
+{
+	if(map)
+		munmap(map, map_size);
+	map = NULL;
+	map_size = 0;
+	if(fd >= 0)
+		::close(fd);
+	fd = -1;
+	delete rg;
+	rg = NULL;
+	seen_states.clear();
+	seen_since.clear();
+}
+
+//==========================================================================//
+
+/*! Заполняет все свободные слоты новыми состояниями генератора. Для каждого слота
+	независимо вырабатываются новые ключ, таблица замен и синхропосылка (<em>RandomGen::rekey()</em>)
+	и новая проверенная последовательность. Заодно восстанавливаются слоты, брошенные аварийно
+	завершившимися процессами (см. <em>isStale()</em>). После заполнения ключевая информация
+	генератора пула уничтожается. Метод можно вызывать одновременно с захватом слотов другими процессами.
+	\returns Количество заполненных слотов.
+*/
+uint32 RandomGenPool::refill()
+{
+	if(!map)
+		return 0;
+	const PoolHeader *header = (const PoolHeader*)map;
+	if(!rg)
+	{
+		rg = new RandomGen(header->seq_size);
+		rg->init();
+	}
+	uint64 now = nowNs();
+	if(seen_states.size() != header->slot_count)
+	{
+		seen_states.assign(header->slot_count, slotState(SlotEmpty));
+		seen_since.assign(header->slot_count, now);
+	}
+	uint64 filling = slotState(SlotFilling, getpid());
+	uint32 filled = 0;
+	uint8 *rows[8];
+	for(uint32 i = 0; i < header->slot_count; i++)
+	{
+		SlotHeader *sh = (SlotHeader*)slot(i);
+		uint64 state = sh->state.load(std::memory_order_acquire);
+		uint32 s = (uint32)state;
+		if(s == SlotReady || ((s == SlotFilling || s == SlotClaimed) && !isStale(i, state, now)))
+			continue;
+		if(!sh->state.compare_exchange_strong(state, filling, std::memory_order_acquire))
+			continue;
+		rg->rekey();
+		rg->createNewRandSequence();
+		rg->cr.getKey(sh->key);
+		for(uint8 j = 0; j < 8; j++)
+			rows[j] = sh->replace_table[j];
+		rg->cr.getReplaceTable(rows);
+		sh->S = rg->S;
+		memcpy((uint8*)(sh + 1), rg->rand_seq, header->seq_size);
+		// Слот мог быть восстановлен другим процессом, если заполнение признано зависшим.
+		uint64 expected = filling;
+		if(sh->state.compare_exchange_strong(expected, slotState(SlotReady), std::memory_order_release))
+			filled++;
+	}
+	// Состояние генератора пула не должно сохраняться в памяти дольше необходимого.
+	rg->wipe();
+	return filled;
+}
+
+//==========================================================================//
+
+/*! Захватывает готовый слот и переносит его состояние в генератор \e _rg, после чего
+	слот обнуляется и освобождается. Генератор \e _rg сразу готов к использованию без вызова
+	<em>init()</em>. Размер его последовательности становится равным размеру последовательности пула.
+	Если во время копирования слот был восстановлен как брошенный, скопированное состояние
+	отбрасывается и захватывается другой слот.
+	\param _rg - инициализируемый генератор.
+	\returns \b true в случае успеха, \b false - если пул не открыт или в нём нет готовых слотов.
+*/
+bool RandomGenPool::claim(RandomGen &_rg)
+{
+	if(!map)
+		return false;
+	PoolHeader *header = (PoolHeader*)map;
+	uint32 count = header->slot_count;
+	uint32 start = header->hint.fetch_add(1, std::memory_order_relaxed);
+	uint64 claimed = slotState(SlotClaimed, getpid());
+	for(uint32 i = 0; i < count; i++)
+	{
+		SlotHeader *sh = (SlotHeader*)slot((start + i) % count);
+		uint64 expected = slotState(SlotReady);
+		if(!sh->state.compare_exchange_strong(expected, claimed, std::memory_order_acquire))
+			continue;
+
+		RandomGen::registerForkHandler();
+		if(_rg.seq_size != header->seq_size || !_rg.rand_seq)
+		{
+			delete [] _rg.rand_seq;
+			_rg.seq_size = header->seq_size;
+			_rg.rand_seq = new uint8[_rg.seq_size];
+		}
+		memcpy(_rg.rand_seq, (const uint8*)(sh + 1), _rg.seq_size);
+		uint8 *rows[8];
+		for(uint8 j = 0; j < 8; j++)
+			rows[j] = sh->replace_table[j];
+		_rg.cr.setKey(sh->key);
+		_rg.cr.setReplaceTable(rows);
+		_rg.S = sh->S;
+		if(sh->state.load(std::memory_order_acquire) != claimed)
+		{
+			_rg.wipe();
+			continue;
+		}
+		_rg.curr_pos = 0;
+		_rg.test_phase = 0;
+		_rg.initialized = true;
+		_rg.deterministic = false;
+		_rg.fork_gen = RandomGen::fork_generation.load(std::memory_order_relaxed);
+
+		// Состояние слота уничтожается до его освобождения.
+		memset(sh->key, 0, sizeof(sh->key));
+		memset(sh->replace_table, 0, sizeof(sh->replace_table));
+		sh->S = 0;
+		memset((uint8*)(sh + 1), 0, header->seq_size);
+		expected = claimed;
+		sh->state.compare_exchange_strong(expected, slotState(SlotEmpty), std::memory_order_release);
+		return true;
+	}
+	return false;
+}
+
+//==========================================================================//
+
+/*! Подсчитывает количество готовых к захвату слотов.
+	\returns Количество готовых слотов (\b 0, если пул не открыт).
+*/
+uint32 RandomGenPool::available() const
+{
+	if(!map)
+		return 0;
+	const PoolHeader *header = (const PoolHeader*)map;
+	uint32 res = 0;
+	for(uint32 i = 0; i < header->slot_count; i++)
+		if(((SlotHeader*)slot(i))->state.load(std::memory_order_relaxed) == slotState(SlotReady))
+			res++;
+	return res;
+}
+
+//==========================================================================//
+
+/*! Отображает открытый файл пула в память. Отображение исключается из дампов памяти
+	и, если это разрешено ограничениями процесса, блокируется в оперативной памяти.
+	\param _size - размер файла в байтах.
+	\returns \b true в случае успеха, \b false - иначе.
+*/
+bool RandomGenPool::mapFile(uint64 _size)
+{
+	void *addr = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(addr == MAP_FAILED)
+		return false;
+	map = (uint8*)addr;
+	map_size = _size;
+#ifdef MADV_DONTDUMP
+	madvise(map, map_size, MADV_DONTDUMP);
+#endif
+	mlock(map, map_size);
+	return true;
+}
+
+//==========================================================================//
+
+/*! Адрес слота с номером \e _num.
+	\param _num - номер слота.
+	\returns Указатель на заголовок слота.
+*/
+uint8 *RandomGenPool::slot(uint32 _num) const
+{
+	const PoolHeader *header = (const PoolHeader*)map;
+	return map + alignUp(sizeof(PoolHeader)) + (uint64)_num * header->slot_size;
+}
+
+//==========================================================================//
+
+/*! Проверяет, брошен ли слот, находящийся в состоянии заполнения или захвата. Слот брошен,
+	если процесса-владельца больше не существует или если состояние слота (вместе с PID
+	владельца) не менялось между вызовами <em>refill()</em> дольше \e staleTimeoutNs.
+	\param _num - номер слота.
+	\param _state - текущее значение поля \e state слота.
+	\param _now - текущее время в наносекундах.
+	\returns \b true, если слот можно восстановить.
+*/
+bool RandomGenPool::isStale(uint32 _num, uint64 _state, uint64 _now)
+{
+	pid_t owner = _state >> 32;
+	if(owner > 0 && kill(owner, 0) < 0 && errno == ESRCH)
+		return true;
+	if(seen_states[_num] != _state)
+	{
+		seen_states[_num] = _state;
+		seen_since[_num] = _now;
+		return false;
+	}
+	return _now - seen_since[_num] >= staleTimeoutNs;
+}
+
+//==========================================================================//
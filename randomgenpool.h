@@ -0,0 +1,45 @@
+
+#ifndef _RANDOMGENPOOL_H_
+#define _RANDOMGENPOOL_H_
+
+#include <vector>
+
+#include "randomgen.h"
+
+//==========================================================================//
+
+//! Класс пула готовых состояний генератора случайных чисел в отображаемом в память файле.
+class RandomGenPool
+{
+private:
+	int fd;											//!< Дескриптор файла пула.
+	uint8 *map;										//!< Отображение файла пула в память.
+	uint64 map_size;								//!< Размер отображения в байтах.
+	RandomGen *rg;									//!< Генератор, заполняющий слоты (только в родительском процессе).
+	std::vector<uint64> seen_states;				//!< Последние замеченные при заполнении состояния слотов.
+	std::vector<uint64> seen_since;					//!< Время (нс), с которого состояние слота не менялось.
+
+public:
+	RandomGenPool();								//!< Конструктор.
+	~RandomGenPool();								//!< Деструктор.
+
+	bool create(const char *_path, uint32 _slots, uint32 _seq_size = fipsBlockSize);	//!< Создание пула.
+	bool open(const char *_path);					//!< Открытие существующего пула.
+	void close();									//!< Закрытие пула.
+
+	uint32 refill();								//!< Заполнение свободных слотов.
+	bool claim(RandomGen &_rg);						//!< Захват готового состояния генератора.
+	uint32 available() const;						//!< Количество готовых слотов.
+
+private:
+	RandomGenPool(const RandomGenPool &);			//!< Копирование запрещено.
+	RandomGenPool &operator=(const RandomGenPool &);	//!< Присваивание запрещено.
+
+	bool mapFile(uint64 _size);						//!< Отображение файла в память.
+	uint8 *slot(uint32 _num) const;					//!< Адрес слота с номером \e _num.
+	bool isStale(uint32 _num, uint64 _state, uint64 _now);	//!< Проверка, брошен ли слот процессом-владельцем.
+};
+
+//==========================================================================//
+
+#endif
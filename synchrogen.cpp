@@ -0,0 +1,154 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "synchrogen.h"
+
+/*! \class SynchroGen
+	Генератор уникальных 64-битных синхропосылок для <em>Cryptographer::gamming()</em> и
+	<em>Cryptographer::gammingWF()</em>. Синхропосылка - это сумма случайного 64-битного начала,
+	выбираемого при создании объекта, и номера из атомарного счётчика (по модулю \f$ 2^{64} \f$).
+	Поэтому все синхропосылки одного объекта гарантированно различны, в отличие от случайных
+	значений <em>RandomGen::nextInt64()</em>, для которых при большом количестве возможны совпадения.
+	Синхропосылки выдаются пакетами: резервирование пакета любого размера стоит одного атомарного
+	сложения и не требует блокировок, поэтому объект можно использовать из многих потоков одновременно.
+	\par Пример:
+	\code
+	RandomGen rg;
+	rg.init();
+	SynchroGen sg(rg);
+	// В каждом потоке:
+	SynchroCache cache(sg);
+	uint64 S;
+	if(cache.next(S))
+		cr.gamming(data, size, S);
+	\endcode
+	\note Уникальность гарантируется в пределах одного объекта (до \e counterLimit синхропосылок).
+	Последовательности разных объектов начинаются со случайных 64-битных значений: \e k объектов,
+	выдавших по \e n синхропосылок, пересекаются с вероятностью не более \f$ k^2 n / 2^{64} \f$
+	(для миллиона объектов по миллиону синхропосылок - порядка \f$ 10^{-7} \f$).
+	\par
+	Дочерний процесс после <em>fork()</em> наследует начало и счётчик родителя. Поэтому при первом
+	резервировании в дочернем процессе выбирается новое случайное начало (из /dev/urandom, так как
+	генератор \e RandomGen может одновременно использоваться другим потоком), счётчик продолжается.
+	Кэши \e SynchroCache отбрасывают пакеты, зарезервированные до <em>fork()</em>.
+*/
+
+//==========================================================================//
+
+/*! Создаёт генератор со случайным префиксом, выработанным \e _rg.
+	\param _rg - генератор случайных чисел.
+*/
+SynchroGen::SynchroGen(RandomGen &_rg) : base(0), counter(0), fork_gen(0)
+{
+	reset(_rg);
+}
+
+//==========================================================================//
+
+/*! Резервирует пакет из \e _count синхропосылок. Зарезервированы значения
+	от \e _first до <em>_first + _count - 1</em> включительно. Метод потокобезопасен.
+	\param _count - размер пакета.
+	\param _first - первая синхропосылка пакета.
+	\returns \b true в случае успеха, \b false - если синхропосылки исчерпаны.
+*/
+bool SynchroGen::reserve(uint32 _count, uint64 &_first)
+{
+	if(fork_gen.load(std::memory_order_acquire) != RandomGen::forkGeneration())
+		rebase();
+	uint64 n = counter.fetch_add(_count, std::memory_order_relaxed);
+	if(n + _count > counterLimit)
+		return false;
+	_first = base.load(std::memory_order_relaxed) + n;
+	return true;
+}
+
+//==========================================================================//
+
+/*! Получение одной синхропосылки. Метод потокобезопасен. Для частых запросов из одного
+	потока предпочтителен класс \e SynchroCache.
+	\param _S - синхропосылка.
+	\returns \b true в случае успеха, \b false - если синхропосылки исчерпаны.
+*/
+bool SynchroGen::next(uint64 &_S)
+{
+	return reserve(1, _S);
+}
+
+//==========================================================================//
+
+/*! Получение пакета синхропосылок. Метод потокобезопасен.
+	\param _S - массив для \e _count синхропосылок.
+	\param _count - размер пакета.
+	\returns \b true в случае успеха, \b false - если синхропосылки исчерпаны.
+*/
+bool SynchroGen::nextBatch(uint64 *_S, uint32 _count)
+{
+	uint64 first;
+	if(!reserve(_count, first))
+		return false;
+	for(uint32 i = 0; i < _count; i++)
+		_S[i] = first + i;
+	return true;
+}
+
+//==========================================================================//
+
+/*! Количество ещё не выданных синхропосылок.
+	\returns Количество синхропосылок, которые можно получить до исчерпания.
+*/
+uint64 SynchroGen::remaining() const
+{
+	uint64 n = counter.load(std::memory_order_relaxed);
+	return n < counterLimit ? counterLimit - n : 0;
+}
+
+//==========================================================================//
+
+/*! Выбирает новое случайное начало и сбрасывает счётчик. Метод нельзя вызывать
+	одновременно с получением синхропосылок.
+	\param _rg - генератор случайных чисел.
+*/
+void SynchroGen::reset(RandomGen &_rg)
+{
+	base.store(_rg.nextInt64(), std::memory_order_relaxed);
+	counter.store(0, std::memory_order_relaxed);
+	fork_gen.store(RandomGen::forkGeneration(), std::memory_order_release);
+}
+
+//==========================================================================//
+
+/*! Выбирает новое случайное начало в дочернем процессе после <em>fork()</em>. Счётчик не
+	сбрасывается, так как его сброс мог бы совпасть с резервированием в других потоках и номера
+	повторились бы. Если /dev/urandom недоступен, выводится сообщение об ошибке и процесс
+	завершается, как и в <em>RandomGen::init()</em>.
+*/
+void SynchroGen::rebase()
+{
+	std::lock_guard<std::mutex> lock(fork_mutex);
+	uint32 gen = RandomGen::forkGeneration();
+	if(fork_gen.load(std::memory_order_relaxed) == gen)
+		return;
+	uint64 b = 0;
+	int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+	{
+		fprintf(stderr, "/dev/urandom open error: %s\n", strerror(errno));
+		exit(1);
+	}
+	ssize_t n = read(fd, &b, sizeof(b));
+	if(n != sizeof(b))
+	{
+		fprintf(stderr, "/dev/urandom read error: %s\n", n < 0 ? strerror(errno) : "short read");
+		exit(1);
+	}
+	close(fd);
+	base.store(b, std::memory_order_relaxed);
+	fork_gen.store(gen, std::memory_order_release);
+}
+
+//==========================================================================//
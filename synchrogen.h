@@ -0,0 +1,79 @@
+
+#ifndef _SYNCHROGEN_H_
+#define _SYNCHROGEN_H_
+
+#include <atomic>
+#include <mutex>
+
+#include "randomgen.h"
+
+//==========================================================================//
+
+//! Класс генератора уникальных синхропосылок.
+class SynchroGen
+{
+public:
+	static const uint32 counterBits = 40;							//!< Количество битов счётчика синхропосылок.
+	static const uint64 counterLimit = (uint64)1 << counterBits;	//!< Максимальное количество синхропосылок объекта.
+
+private:
+	std::atomic<uint64> base;						//!< Случайное начало последовательности синхропосылок.
+	std::atomic<uint64> counter;					//!< Номер следующей свободной синхропосылки.
+	std::atomic<uint32> fork_gen;					//!< Поколение процесса, для которого выбрано \e base.
+	std::mutex fork_mutex;							//!< Блокировка выбора нового начала после <em>fork()</em>.
+
+public:
+	explicit SynchroGen(RandomGen &_rg);			//!< Конструктор.
+
+	bool reserve(uint32 _count, uint64 &_first);	//!< Резервирование пакета синхропосылок.
+	bool next(uint64 &_S);							//!< Получение одной синхропосылки.
+	bool nextBatch(uint64 *_S, uint32 _count);		//!< Получение пакета синхропосылок.
+	uint64 remaining() const;						//!< Количество оставшихся синхропосылок.
+
+	void reset(RandomGen &_rg);						//!< Выбор нового начала и сброс счётчика.
+
+private:
+	void rebase();									//!< Выбор нового начала в дочернем процессе.
+
+	SynchroGen(const SynchroGen &);					//!< Копирование запрещено.
+	SynchroGen &operator=(const SynchroGen &);		//!< Присваивание запрещено.
+};
+
+//==========================================================================//
+
+//! Класс локального (для одного потока) кэша синхропосылок.
+class SynchroCache
+{
+private:
+	SynchroGen &sg;									//!< Общий генератор синхропосылок.
+	uint32 batch;									//!< Размер резервируемого пакета.
+	uint64 curr;									//!< Следующая синхропосылка пакета.
+	uint64 end;										//!< Граница текущего пакета.
+	uint32 fork_gen;								//!< Поколение процесса, в котором зарезервирован пакет.
+
+public:
+	//! Конструктор кэша, резервирующего у \e _sg пакеты по \e _batch синхропосылок.
+	SynchroCache(SynchroGen &_sg, uint32 _batch = 4096) : sg(_sg), batch(_batch ? _batch : 1), curr(0), end(0), fork_gen(0) {}
+
+	//! Получение синхропосылки; \b false, если синхропосылки исчерпаны. После <em>fork()</em>
+	//! остаток пакета родительского процесса отбрасывается.
+	bool next(uint64 &_S)
+	{
+		if(curr == end || fork_gen != RandomGen::forkGeneration())
+		{
+			fork_gen = RandomGen::forkGeneration();
+			if(!sg.reserve(batch, curr))
+			{
+				end = curr;
+				return false;
+			}
+			end = curr + batch;
+		}
+		_S = curr++;
+		return true;
+	}
+};
+
+//==========================================================================//
+
+#endif
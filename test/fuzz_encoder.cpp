@@ -0,0 +1,104 @@
+/*! \file fuzz_encoder.cpp
+	Цель libFuzzer \e crypton-fuzz-encoder: произвольные данные кодируются \e TokenEncoder
+	каждой реализацией, поддерживаемой процессором (scalar, SSSE3, AVX2), и эталоном (\e reference.h).
+	Проверяются совпадение с эталоном, длина результата и совпадение кодирования по частям
+	из целого числа групп (<em>TokenEncoder::groupSize()</em>) с кодированием за один вызов.
+	Результат записывается в буфер точного размера, поэтому выход за его границу обнаруживает
+	AddressSanitizer. При расхождении выполнение прерывается (\e abort()).
+	\par Формат входных данных:
+	\code
+	[формат] [количество групп в части] [данные]
+	\endcode
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "tokenencoder.h"
+#include "reference.h"
+
+using namespace std;
+
+//==========================================================================//
+
+const uint32 maxDataSize = 4096;	//!< Максимальный размер данных.
+
+static const char *implementations[] = {"scalar", "ssse3", "avx2"};	//!< Реализации \e TokenEncoder.
+
+static const char hexDigits[] = "0123456789abcdef";
+static const char base32Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+static const char base64UrlDigits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+//==========================================================================//
+
+/*! Прерывает выполнение при расхождении.
+	\param _ok - результат проверки.
+	\param _what - описание проверки.
+*/
+static void require(bool _ok, const char *_what)
+{
+	if(_ok)
+		return;
+	fprintf(stderr, "crypton-fuzz-encoder (%s): %s\n", TokenEncoder::implementation(), _what);
+	abort();
+}
+
+//==========================================================================//
+
+/*! Точка входа libFuzzer.
+	\param _data - входные данные.
+	\param _size - размер \e _data.
+	\returns \b 0.
+*/
+extern "C" int LLVMFuzzerTestOneInput(const uint8 *_data, size_t _size)
+{
+	if(_size < 2)
+		return 0;
+	TokenEncoder::Format format = (TokenEncoder::Format)(_data[0] % 3);
+	uint32 groups = _data[1] + 1;
+	const uint8 *src = _data + 2;
+	uint32 size = _size - 2 < maxDataSize ? _size - 2 : maxDataSize;
+
+	uint32 len = TokenEncoder::encodedLength(format, size);
+	vector<char> expected(len + 1);
+	uint32 n;
+	if(format == TokenEncoder::Hex)
+		n = referenceEncode(src, size, hexDigits, 4, &expected[0]);
+	else if(format == TokenEncoder::Base32)
+		n = referenceEncode(src, size, base32Digits, 5, &expected[0]);
+	else
+		n = referenceEncode(src, size, base64UrlDigits, 6, &expected[0]);
+	require(n == len, "encodedLength differs from reference");
+
+	for(uint32 impl = 0; impl < sizeof(implementations) / sizeof(implementations[0]); impl++)
+	{
+		if(!TokenEncoder::setImplementation(implementations[impl]))
+			continue;
+
+		// Отдельная копия данных и буфер точного размера для каждого кодирования.
+		vector<uint8> in(src, src + size);
+		vector<char> out(len);
+		TokenEncoder::encode(format, in.data(), size, out.data());
+		require(!len || !memcmp(out.data(), &expected[0], len), "output differs from reference");
+
+		// Кодирование по частям из целого числа групп.
+		uint32 chunk = groups * TokenEncoder::groupSize(format);
+		vector<char> joined;
+		for(uint32 pos = 0; pos < size; pos += chunk)
+		{
+			uint32 part = size - pos < chunk ? size - pos : chunk;
+			vector<uint8> part_in(src + pos, src + pos + part);
+			vector<char> part_out(TokenEncoder::encodedLength(format, part));
+			TokenEncoder::encode(format, part_in.data(), part, part_out.data());
+			joined.insert(joined.end(), part_out.begin(), part_out.end());
+		}
+		require(joined.size() == len && (!len || !memcmp(joined.data(), &expected[0], len)),
+			"encoding by chunks differs from one call");
+	}
+	return 0;
+}
+
+//==========================================================================//
@@ -0,0 +1,206 @@
+/*! \file fuzz_modes.cpp
+	Цель libFuzzer \e crypton-fuzz-modes: произвольные ключ, таблица замен, синхропосылка, данные
+	и разбиение данных на части подаются в режимы \e Cryptographer и в эталон (\e reference.h).
+	Проверяются побитное совпадение с эталоном (включая синхропосылку после каждой части),
+	обратимость преобразований при обработке по частям и совпадение простой замены по частям
+	с обработкой за один вызов. При расхождении выполнение прерывается (\e abort()).
+	\par Формат входных данных (недостающие байты считаются нулевыми):
+	\code
+	[режим] [ключ, 32 байта] [таблица замен, 64 байта по две тетрады] [синхропосылка, 8 байтов]
+	[количество частей N] [N длин частей] [данные]
+	\endcode
+	\par Использование:
+	\code
+	cmake -DCMAKE_CXX_COMPILER=clang++ -DCRYPTON_FUZZ=ON ..
+	crypton-fuzz-modes corpus/
+	\endcode
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "cryptographer.h"
+#include "reference.h"
+
+using namespace std;
+
+//==========================================================================//
+
+const uint32 maxDataSize = 4096;	//!< Максимальный размер данных.
+const uint32 maxChunks = 16;		//!< Максимальное количество частей.
+
+//! Режимы.
+enum Mode
+{
+	SimpleReplace,		//!< Простая замена.
+	Gamming,			//!< Гаммирование.
+	GammingWF,			//!< Гаммирование с обратной связью.
+	ImiIns,				//!< Имитовставка.
+	ModeCount			//!< Количество режимов.
+};
+
+//! Чтение входных данных фаззера.
+struct Input
+{
+	const uint8 *data;	//!< Данные.
+	size_t size;		//!< Размер данных.
+
+	/*! Следующий байт (\b 0 за концом данных).
+	*/
+	uint8 next()
+	{
+		if(!size)
+			return 0;
+		size--;
+		return *data++;
+	}
+};
+
+//==========================================================================//
+
+/*! Прерывает выполнение при расхождении.
+	\param _ok - результат проверки.
+	\param _what - описание проверки.
+*/
+static void require(bool _ok, const char *_what)
+{
+	if(_ok)
+		return;
+	fprintf(stderr, "crypton-fuzz-modes: %s\n", _what);
+	abort();
+}
+
+//==========================================================================//
+
+/*! Преобразование данных по частям объектом библиотеки и эталоном, сравнение после каждой части.
+	\param _cr - объект библиотеки.
+	\param _ref - эталон.
+	\param _mode - режим.
+	\param _encoding - зашифрование или расшифрование.
+	\param _chunks - размеры частей.
+	\param _data - данные; на выходе - результат.
+	\param _S - синхропосылка; на выходе - синхропосылка после последней части.
+*/
+static void transform(const Cryptographer &_cr, const ReferenceCryptographer &_ref, Mode _mode, bool _encoding,
+	const vector<uint32> &_chunks, vector<uint8> &_data, uint64 &_S)
+{
+	vector<uint8> expected(_data);
+	uint64 S = _S;
+	for(uint32 i = 0, pos = 0; i < _chunks.size(); pos += _chunks[i], i++)
+	{
+		uint8 *a = _data.data() + pos;
+		uint8 *b = expected.data() + pos;
+		switch(_mode)
+		{
+		case SimpleReplace:
+			require(_cr.simpleReplace(a, _chunks[i], _encoding) == _ref.simpleReplace(b, _chunks[i], _encoding),
+				"simpleReplace result");
+			break;
+		case Gamming:
+			_cr.gamming(a, _chunks[i], _S);
+			_ref.gamming(b, _chunks[i], S);
+			break;
+		default:
+			_cr.gammingWF(a, _chunks[i], _S, _encoding);
+			_ref.gammingWF(b, _chunks[i], S, _encoding);
+			break;
+		}
+		require(_S == S, "synchro differs from reference");
+		require(!_chunks[i] || !memcmp(a, b, _chunks[i]), "output differs from reference");
+	}
+}
+
+//==========================================================================//
+
+/*! Точка входа libFuzzer.
+	\param _data - входные данные.
+	\param _size - размер \e _data.
+	\returns \b 0.
+*/
+extern "C" int LLVMFuzzerTestOneInput(const uint8 *_data, size_t _size)
+{
+	Input in = {_data, _size};
+	uint8 mode_byte = in.next();
+	Mode mode = (Mode)(mode_byte % ModeCount);
+	uint32 key[8];
+	uint8 table[8][16];
+	uint64 S0 = 0;
+	for(int i = 0; i < 8; i++)
+	{
+		key[i] = 0;
+		for(int j = 0; j < 4; j++)
+			key[i] |= (uint32)in.next() << (j * 8);
+	}
+	for(int i = 0; i < 8; i++)
+		for(int j = 0; j < 16; j += 2)
+		{
+			uint8 b = in.next();
+			table[i][j] = b & 0xf;
+			table[i][j + 1] = b >> 4;
+		}
+	for(int j = 0; j < 8; j++)
+		S0 |= (uint64)in.next() << (j * 8);
+
+	// Длины частей; для простой замены - кратные 8, иначе произвольные (хвост внутри потока).
+	vector<uint32> chunks;
+	uint32 chunk_count = in.next() % (maxChunks + 1);
+	uint32 total = 0;
+	for(uint32 i = 0; i < chunk_count; i++)
+	{
+		uint32 c = in.next();
+		if(mode == SimpleReplace)
+			c = c / 8 * 8;
+		chunks.push_back(c);
+		total += c;
+	}
+	uint32 rest = in.size < maxDataSize ? in.size : maxDataSize;
+	if(mode == SimpleReplace)
+		rest = rest / 8 * 8;
+	total = total < rest ? total : rest;
+	// Части не выходят за данные, остаток данных - последняя часть.
+	for(uint32 i = 0, sum = 0; i < chunks.size(); i++)
+	{
+		if(chunks[i] > total - sum)
+			chunks[i] = total - sum;
+		sum += chunks[i];
+	}
+	chunks.push_back(rest - total);
+	vector<uint8> plain(in.data, in.data + rest);
+
+	ReferenceCryptographer ref(key, table);
+	Cryptographer cr;
+	ref.setup(cr);
+
+	if(mode == ImiIns)
+	{
+		vector<uint8> copy(plain);
+		uint8 *p = copy.data();
+		require(cr.imiIns(p, rest) == ref.imiIns(p, rest), "imiIns differs from reference");
+		require(copy == plain, "imiIns modified data");
+		return 0;
+	}
+
+	bool encoding = !(mode_byte & 0x80);
+	vector<uint8> data(plain);
+	uint64 S = S0;
+	transform(cr, ref, mode, encoding, chunks, data, S);
+
+	if(mode == SimpleReplace)
+	{
+		// Простая замена по частям совпадает с обработкой за один вызов.
+		vector<uint8> whole(plain);
+		require(cr.simpleReplace(whole.data(), rest, encoding), "simpleReplace rejected size");
+		require(whole == data, "simpleReplace by chunks differs from one call");
+	}
+
+	// Обратное преобразование с тем же разбиением восстанавливает данные.
+	S = S0;
+	transform(cr, ref, mode, !encoding, chunks, data, S);
+	require(data == plain, "inverse transform does not restore data");
+	return 0;
+}
+
+//==========================================================================//
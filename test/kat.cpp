@@ -0,0 +1,504 @@
+/*! \file kat.cpp
+	Тест \e crypton-test проверяет, что реализации библиотеки побитно совпадают с эталоном
+	(\e reference.h). Проверяются:
+	- контрольные примеры (KAT) всех режимов \e Cryptographer для фиксированных ключа, таблицы
+	замен (тестовый набор ГОСТ Р 34.11-94) и синхропосылки, полученные на эталоне;
+	- контрольные примеры RFC 4648 для \e TokenEncoder;
+	- случайные ключи, таблицы замен, синхропосылки и длины (в том числе не кратные 8 - обработка
+	хвоста) для всех режимов, обратимость преобразований, обработка данных по частям;
+	- все форматы \e TokenEncoder со всеми реализациями, поддерживаемыми процессором (scalar,
+	SSSE3, AVX2), на невыровненных буферах с контролем выхода за границу результата;
+	- отсутствие совпадающих паролей \e PasswordGen с политикой в родительском и дочернем
+	процессах после <em>fork()</em>.
+	При первом расхождении по каждой проверке в поток ошибок выводится описание, и тест
+	завершается с кодом \b 1.
+	\par Использование:
+	\code
+	crypton-test [iterations] [seed]
+	\endcode
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "cryptographer.h"
+#include "passwordgen.h"
+#include "tokenencoder.h"
+#include "reference.h"
+
+using namespace std;
+
+//==========================================================================//
+
+static const uint32 katKey[8] = {0x733d2c20, 0x65686573, 0x74746769, 0x79676120,
+	0x626e7373, 0x20657369, 0x6e6f6868, 0x20646465};	//!< Ключ контрольных примеров.
+
+//! Таблица замен контрольных примеров (id-GostR3411-94-TestParamSet).
+static const uint8 katTable[8][16] = {
+	{4, 10, 9, 2, 13, 8, 0, 14, 6, 11, 1, 12, 7, 15, 5, 3},
+	{14, 11, 4, 12, 6, 13, 15, 10, 2, 3, 8, 1, 0, 7, 5, 9},
+	{5, 8, 1, 13, 10, 3, 4, 2, 14, 15, 12, 7, 6, 0, 9, 11},
+	{7, 13, 10, 1, 0, 8, 9, 15, 14, 4, 6, 12, 11, 2, 5, 3},
+	{6, 12, 7, 1, 5, 15, 13, 8, 4, 10, 9, 14, 0, 3, 11, 2},
+	{4, 11, 10, 0, 7, 2, 1, 13, 3, 6, 8, 5, 9, 12, 15, 14},
+	{13, 11, 4, 1, 3, 15, 5, 9, 0, 10, 14, 7, 6, 8, 2, 12},
+	{1, 15, 13, 0, 5, 7, 10, 4, 9, 2, 3, 14, 6, 11, 8, 12}};
+
+static const uint64 katSynchro = 0x0123456789abcdefULL;	//!< Синхропосылка контрольных примеров.
+
+//! Простая замена (зашифрование) байтов 0, 1, ..., 31.
+static const char katSimpleReplace[] = "6d5e789cf889b099e44c2f8b647a50c1cb776770248db708575d30e6718235fb";
+
+//! Гаммирование байтов 0, 1, ..., 36 и синхропосылка после него.
+static const char katGamming[] = "aa45062816cee5ecb3e1f29fd4c7229a2c9e131858e8c3ed09484f6c93bf0c0c31707754ab";
+static const uint64 katGammingS = 0xc566d13830ba8ab8ULL;
+
+//! Гаммирование с обратной связью (зашифрование) байтов 0, 1, ..., 36 и синхропосылка после него.
+static const char katGammingWF[] = "b487b42f2cc864c68742e90c309ec9eb170b571fb68d6e995bc5b62443748d5c042b2c78c1";
+static const uint64 katGammingWFS = 0x5c8d744324b6c55bULL;
+
+static const uint32 katImiLengths[] = {0, 1, 7, 8, 9, 15, 16, 17, 37, 64};	//!< Длины данных имитовставок.
+
+//! Имитовставки байтов 0, 1, ... для длин \e katImiLengths.
+static const uint32 katImiIns[] = {0x00000000, 0x04fdace0, 0x8b6ee1d3, 0xaab08716, 0x36bbe353,
+	0x3f38407a, 0x0e23396c, 0x944b99bd, 0xd0e52d2a, 0x473f3cb7};
+
+//! Контрольный пример RFC 4648.
+struct EncoderVector
+{
+	const char *data;		//!< Исходные данные.
+	const char *hex;		//!< hex.
+	const char *base32;		//!< base32 без дополнения.
+	const char *base64url;	//!< base64url без дополнения.
+};
+
+static const EncoderVector encoderVectors[] = {
+	{"", "", "", ""},
+	{"f", "66", "MY", "Zg"},
+	{"fo", "666f", "MZXQ", "Zm8"},
+	{"foo", "666f6f", "MZXW6", "Zm9v"},
+	{"foob", "666f6f62", "MZXW6YQ", "Zm9vYg"},
+	{"fooba", "666f6f6261", "MZXW6YTB", "Zm9vYmE"},
+	{"foobar", "666f6f626172", "MZXW6YTBOI", "Zm9vYmFy"}};
+
+static const char *encoderImplementations[] = {"scalar", "ssse3", "avx2"};	//!< Реализации \e TokenEncoder.
+
+static const char hexDigits[] = "0123456789abcdef";
+static const char base32Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+static const char base64UrlDigits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+static uint64 checks = 0;			//!< Количество выполненных проверок.
+static uint64 failures = 0;			//!< Количество расхождений.
+
+//==========================================================================//
+
+/*! Генератор псевдослучайных чисел теста (splitmix64). Не зависит от \e RandomGen, чтобы
+	тест воспроизводился по \e seed.
+*/
+static uint64 nextRandom(uint64 &_state)
+{
+	uint64 z = (_state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+//==========================================================================//
+
+/*! Учитывает результат проверки; при расхождении выводит описание.
+	\param _ok - результат проверки.
+	\param _format - описание проверки (как у \e printf()).
+	\returns \e _ok.
+*/
+static bool check(bool _ok, const char *_format, ...)
+{
+	checks++;
+	if(_ok)
+		return true;
+	failures++;
+	va_list args;
+	va_start(args, _format);
+	fprintf(stderr, "FAIL: ");
+	vfprintf(stderr, _format, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+	return false;
+}
+
+//==========================================================================//
+
+/*! Шестнадцатеричная запись данных.
+*/
+static string toHex(const uint8 *_data, uint32 _size)
+{
+	string res;
+	for(uint32 i = 0; i < _size; i++)
+	{
+		res += hexDigits[_data[i] >> 4];
+		res += hexDigits[_data[i] & 0xf];
+	}
+	return res;
+}
+
+//==========================================================================//
+
+/*! Проверка контрольных примеров режимов на эталоне и на библиотеке.
+*/
+static void testKnownAnswers()
+{
+	ReferenceCryptographer ref(katKey, katTable);
+	Cryptographer cr;
+	ref.setup(cr);
+	uint8 plain[64], buf[64];
+	for(uint32 i = 0; i < sizeof(plain); i++)
+		plain[i] = i;
+
+	for(int impl = 0; impl < 2; impl++)
+	{
+		const char *name = impl ? "library" : "reference";
+		uint64 S;
+
+		memcpy(buf, plain, sizeof(buf));
+		if(impl)
+			cr.simpleReplace(buf, 32, true);
+		else
+			ref.simpleReplace(buf, 32, true);
+		check(toHex(buf, 32) == katSimpleReplace, "KAT simpleReplace (%s): %s", name, toHex(buf, 32).c_str());
+
+		memcpy(buf, plain, sizeof(buf));
+		S = katSynchro;
+		if(impl)
+			cr.gamming(buf, 37, S);
+		else
+			ref.gamming(buf, 37, S);
+		check(toHex(buf, 37) == katGamming && S == katGammingS, "KAT gamming (%s): %s", name, toHex(buf, 37).c_str());
+
+		memcpy(buf, plain, sizeof(buf));
+		S = katSynchro;
+		if(impl)
+			cr.gammingWF(buf, 37, S, true);
+		else
+			ref.gammingWF(buf, 37, S, true);
+		check(toHex(buf, 37) == katGammingWF && S == katGammingWFS, "KAT gammingWF (%s): %s", name, toHex(buf, 37).c_str());
+
+		for(uint32 i = 0; i < sizeof(katImiLengths) / sizeof(katImiLengths[0]); i++)
+		{
+			memcpy(buf, plain, sizeof(buf));
+			uint32 imi = impl ? cr.imiIns(buf, katImiLengths[i]) : ref.imiIns(buf, katImiLengths[i]);
+			check(imi == katImiIns[i], "KAT imiIns (%s), size %u: %08x", name, katImiLengths[i], imi);
+		}
+	}
+}
+
+//==========================================================================//
+
+/*! Проверка контрольных примеров RFC 4648.
+*/
+static void testEncoderVectors()
+{
+	char buf[64];
+	for(uint32 i = 0; i < sizeof(encoderVectors) / sizeof(encoderVectors[0]); i++)
+	{
+		const EncoderVector &v = encoderVectors[i];
+		const uint8 *data = (const uint8*)v.data;
+		uint32 size = strlen(v.data);
+
+		TokenEncoder::encodeHex(data, size, buf);
+		check(string(buf, TokenEncoder::encodedLength(TokenEncoder::Hex, size)) == v.hex, "RFC 4648 hex (%s) \"%s\"", TokenEncoder::implementation(), v.data);
+		TokenEncoder::encodeBase32(data, size, buf);
+		check(string(buf, TokenEncoder::encodedLength(TokenEncoder::Base32, size)) == v.base32, "RFC 4648 base32 (%s) \"%s\"", TokenEncoder::implementation(), v.data);
+		TokenEncoder::encodeBase64Url(data, size, buf);
+		check(string(buf, TokenEncoder::encodedLength(TokenEncoder::Base64Url, size)) == v.base64url, "RFC 4648 base64url (%s) \"%s\"", TokenEncoder::implementation(), v.data);
+	}
+}
+
+//==========================================================================//
+
+/*! Случайные ключ и таблица замен. Иногда элементы ключа берутся близкими к \f$ 2^{32} \f$,
+	чтобы чаще проверялось сложение по модулю \f$ 2^{32} - 1 \f$.
+*/
+static void randomKey(uint64 &_state, uint32 *_key, uint8 (*_table)[16])
+{
+	for(int i = 0; i < 8; i++)
+	{
+		_key[i] = nextRandom(_state);
+		if(nextRandom(_state) % 8 == 0)
+			_key[i] = 0xffffffff - nextRandom(_state) % 4;
+		for(int j = 0; j < 16; j++)
+			_table[i][j] = nextRandom(_state) & 0xf;
+	}
+}
+
+//==========================================================================//
+
+/*! Случайное разбиение \e _size байтов на части для обработки по частям. Все части, кроме
+	последней, имеют размер, кратный 8.
+*/
+static vector<uint32> randomChunks(uint64 &_state, uint32 _size)
+{
+	vector<uint32> chunks;
+	while(_size)
+	{
+		uint32 c = (nextRandom(_state) % (_size / 8 + 1)) * 8;
+		if(!c || c > _size)
+			c = _size;
+		chunks.push_back(c);
+		_size -= c;
+	}
+	return chunks;
+}
+
+//==========================================================================//
+
+/*! Сравнение режимов библиотеки с эталоном на случайных данных.
+	\param _iterations - количество случайных ключей.
+	\param _state - состояние генератора теста.
+*/
+static void testCryptographer(uint32 _iterations, uint64 &_state)
+{
+	const uint32 maxSize = 300;
+	uint32 key[8];
+	uint8 table[8][16];
+	uint8 data[maxSize], a[maxSize], b[maxSize];
+	for(uint32 it = 0; it < _iterations; it++)
+	{
+		randomKey(_state, key, table);
+		ReferenceCryptographer ref(key, table);
+		Cryptographer cr;
+		ref.setup(cr);
+		Cryptographer copy(cr);
+		Cryptographer assigned;
+		assigned = cr;
+
+		uint32 size = nextRandom(_state) % 4 ? nextRandom(_state) % 40 : nextRandom(_state) % maxSize;
+		for(uint32 i = 0; i < size; i++)
+			data[i] = nextRandom(_state);
+		uint64 S0 = nextRandom(_state);
+
+		// Простая замена.
+		memcpy(a, data, size);
+		memcpy(b, data, size);
+		bool ra = cr.simpleReplace(a, size, true);
+		bool rb = ref.simpleReplace(b, size, true);
+		check(ra == rb && !memcmp(a, b, size), "simpleReplace encode, iteration %u, size %u", it, size);
+		ra = copy.simpleReplace(a, size, false);
+		check(ra == rb && !memcmp(a, data, size), "simpleReplace decode, iteration %u, size %u", it, size);
+
+		// Гаммирование.
+		uint64 Sa = S0, Sb = S0;
+		memcpy(a, data, size);
+		memcpy(b, data, size);
+		cr.gamming(a, size, Sa);
+		ref.gamming(b, size, Sb);
+		check(Sa == Sb && !memcmp(a, b, size), "gamming, iteration %u, size %u", it, size);
+		Sa = S0;
+		assigned.gamming(a, size, Sa);
+		check(Sa == Sb && !memcmp(a, data, size), "gamming inverse, iteration %u, size %u", it, size);
+
+		// Гаммирование с обратной связью.
+		Sa = Sb = S0;
+		memcpy(a, data, size);
+		memcpy(b, data, size);
+		cr.gammingWF(a, size, Sa, true);
+		ref.gammingWF(b, size, Sb, true);
+		check(Sa == Sb && !memcmp(a, b, size), "gammingWF encode, iteration %u, size %u", it, size);
+		Sa = S0;
+		copy.gammingWF(a, size, Sa, false);
+		check(Sa == Sb && !memcmp(a, data, size), "gammingWF decode, iteration %u, size %u", it, size);
+
+		// Имитовставка.
+		memcpy(a, data, size);
+		check(cr.imiIns(a, size) == ref.imiIns(data, size), "imiIns, iteration %u, size %u", it, size);
+
+		// Обработка по частям: синхропосылка переходит от части к части.
+		vector<uint32> chunks = randomChunks(_state, size);
+		Sa = Sb = S0;
+		uint64 Wa = S0, Wb = S0;
+		memcpy(a, data, size);
+		memcpy(b, data, size);
+		for(uint32 i = 0, pos = 0; i < chunks.size(); pos += chunks[i], i++)
+		{
+			cr.gamming(a + pos, chunks[i], Sa);
+			ref.gamming(b + pos, chunks[i], Sb);
+		}
+		check(Sa == Sb && !memcmp(a, b, size), "gamming by %u chunks, iteration %u, size %u", (uint32)chunks.size(), it, size);
+		memcpy(a, data, size);
+		memcpy(b, data, size);
+		for(uint32 i = 0, pos = 0; i < chunks.size(); pos += chunks[i], i++)
+		{
+			cr.gammingWF(a + pos, chunks[i], Wa, true);
+			ref.gammingWF(b + pos, chunks[i], Wb, true);
+		}
+		check(Wa == Wb && !memcmp(a, b, size), "gammingWF by %u chunks, iteration %u, size %u", (uint32)chunks.size(), it, size);
+	}
+}
+
+//==========================================================================//
+
+/*! Сравнение кодирования \e TokenEncoder с эталоном на случайных данных, длинах и смещениях.
+	\param _iterations - количество проверок.
+	\param _state - состояние генератора теста.
+*/
+static void testEncoders(uint32 _iterations, uint64 &_state)
+{
+	const uint32 maxSize = 1024;
+	const uint32 guard = 64;
+	vector<uint8> src(maxSize + 64);
+	vector<char> dst(maxSize * 2 + 64 + guard), expected(maxSize * 2 + 64);
+	for(uint32 it = 0; it < _iterations; it++)
+	{
+		uint32 size = nextRandom(_state) % 4 ? nextRandom(_state) % 100 : nextRandom(_state) % maxSize;
+		uint32 src_offset = nextRandom(_state) % 32;
+		uint32 dst_offset = nextRandom(_state) % 32;
+		for(uint32 i = 0; i < size; i++)
+			src[src_offset + i] = nextRandom(_state);
+
+		for(int f = 0; f < 3; f++)
+		{
+			TokenEncoder::Format format = (TokenEncoder::Format)f;
+			uint32 n;
+			if(format == TokenEncoder::Hex)
+				n = referenceEncode(&src[src_offset], size, hexDigits, 4, &expected[0]);
+			else if(format == TokenEncoder::Base32)
+				n = referenceEncode(&src[src_offset], size, base32Digits, 5, &expected[0]);
+			else
+				n = referenceEncode(&src[src_offset], size, base64UrlDigits, 6, &expected[0]);
+			check(n == TokenEncoder::encodedLength(format, size), "encodedLength, format %d, size %u", f, size);
+
+			memset(&dst[0], '#', dst.size());
+			TokenEncoder::encode(format, &src[src_offset], size, &dst[dst_offset]);
+			bool overrun = false;
+			for(uint32 i = 0; i < guard; i++)
+				if(dst[dst_offset + n + i] != '#')
+					overrun = true;
+			check(!memcmp(&dst[dst_offset], &expected[0], n) && !overrun && (!dst_offset || dst[dst_offset - 1] == '#'),
+				"encode (%s), format %d, size %u, offsets %u/%u", TokenEncoder::implementation(), f, size, src_offset, dst_offset);
+		}
+	}
+}
+
+//==========================================================================//
+
+/*! Проверка, что после <em>fork()</em> генератор паролей с политикой в дочернем процессе
+	не продолжает последовательность символов родителя. Политика перемешивает символы пароля,
+	поэтому сравниваются наборы символов паролей.
+*/
+static void testForkedPasswords()
+{
+	const uint32 count = 32;
+	const uint32 length = 16;
+	PasswordGen pg;
+	PasswordPolicy policy;
+	policy.addClass("0123456789", 2);
+	policy.addClass("ABCDEFGHIJKLMNOPQRSTUVWXYZ", 2);
+	pg.setPolicy(policy);
+	string pass;
+	pg.nextPassword(pass, length);
+
+	int fds[2];
+	if(!check(pipe(fds) == 0, "fork test: pipe"))
+		return;
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = fork();
+	if(pid == 0)
+	{
+		close(fds[0]);
+		string out;
+		for(uint32 i = 0; i < count; i++)
+		{
+			pg.nextPassword(pass, length);
+			out += pass;
+		}
+		bool ok = write(fds[1], out.data(), out.size()) == (ssize_t)out.size();
+		_exit(ok ? 0 : 1);
+	}
+	close(fds[1]);
+	if(!check(pid > 0, "fork test: fork"))
+	{
+		close(fds[0]);
+		return;
+	}
+	string parent;
+	for(uint32 i = 0; i < count; i++)
+	{
+		pg.nextPassword(pass, length);
+		parent += pass;
+	}
+	string child(count * length, 0);
+	uint32 got = 0;
+	for(ssize_t n; got < child.size() && (n = read(fds[0], &child[got], child.size() - got)) > 0;)
+		got += n;
+	close(fds[0]);
+	int status = 0;
+	waitpid(pid, &status, 0);
+	if(!check(got == child.size() && WIFEXITED(status) && !WEXITSTATUS(status), "fork test: child output"))
+		return;
+
+	// Общие символы паролей с одинаковыми номерами: при продолжении последовательности родителя
+	// совпадают все необязательные символы (около 3/4), у независимых паролей - около 1/4.
+	uint32 common = 0;
+	for(uint32 i = 0; i < count; i++)
+	{
+		string a = parent.substr(i * length, length);
+		string b = child.substr(i * length, length);
+		sort(a.begin(), a.end());
+		sort(b.begin(), b.end());
+		for(uint32 x = 0, y = 0; x < length && y < length;)
+			if(a[x] == b[y])
+				common++, x++, y++;
+			else if(a[x] < b[y])
+				x++;
+			else
+				y++;
+	}
+	check(common * 2 < count * length, "fork test: %u of %u characters of the child repeat the parent's", common,
+		count * length);
+}
+
+//==========================================================================//
+
+/*! Точка входа.
+	\param argc - количество аргументов.
+	\param argv - аргументы: количество итераций (по умолчанию 2000) и начальное значение генератора.
+	\returns \b 0, если расхождений нет, \b 1 - иначе.
+*/
+int main(int argc, char **argv)
+{
+	uint32 iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000;
+	uint64 seed = argc > 2 ? strtoull(argv[2], NULL, 0) : 1;
+	uint64 state = seed;
+
+	testKnownAnswers();
+	testCryptographer(iterations, state);
+
+	// Каждая поддерживаемая реализация кодирования проверяется на одних и тех же данных.
+	string default_impl = TokenEncoder::implementation();
+	string tested;
+	for(uint32 i = 0; i < sizeof(encoderImplementations) / sizeof(encoderImplementations[0]); i++)
+	{
+		if(!TokenEncoder::setImplementation(encoderImplementations[i]))
+			continue;
+		uint64 encoder_state = state;
+		testEncoderVectors();
+		testEncoders(iterations * 4, encoder_state);
+		tested += tested.empty() ? "" : ",";
+		tested += encoderImplementations[i];
+	}
+	TokenEncoder::setImplementation(default_impl.c_str());
+	testForkedPasswords();
+
+	printf("crypton-test: %llu checks, %llu failures (seed %llu, encoders %s)\n", (unsigned long long)checks,
+		(unsigned long long)failures, (unsigned long long)seed, tested.c_str());
+	return failures ? 1 : 0;
+}
+
+//==========================================================================//
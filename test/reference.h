@@ -0,0 +1,220 @@
+/*! \file reference.h
+	Эталонная реализация преобразований \e Cryptographer и кодирования \e TokenEncoder для тестов.
+	Код преобразований - замороженная копия исходного <em>Cryptographer::mainStep()</em>, циклов
+	32-З, 32-Р, 16-З и режимов; он намеренно не оптимизируется и не меняется вместе с библиотекой.
+	Любая оптимизированная реализация библиотеки должна совпадать с ним побитно.
+	\note Сложение с ключом в основном шаге выполняется по модулю \f$ 2^{32} - 1 \f$, как в
+	библиотеке, поэтому опубликованные контрольные примеры ГОСТ 28147-89 к ней не применимы.
+*/
+
+#ifndef _REFERENCE_H_
+#define _REFERENCE_H_
+
+#include <string.h>
+
+#include "cryptographer.h"
+
+//==========================================================================//
+
+//! Эталонная реализация криптографических преобразований.
+class ReferenceCryptographer
+{
+private:
+	uint32 key[8];									//!< Ключ.
+	uint8 table[8][16];								//!< Таблица замен.
+
+public:
+	/*! Создаёт эталон с ключом \e _key и таблицей замен \e _table.
+	*/
+	ReferenceCryptographer(const uint32 *_key, const uint8 (*_table)[16])
+	{
+		memcpy(key, _key, sizeof(key));
+		memcpy(table, _table, sizeof(table));
+	}
+
+	/*! Основной шаг криптопреобразования.
+	*/
+	uint64 mainStep(uint64 _data, uint8 _key_num) const
+	{
+		uint32 N1 = _data & 0xffffffffULL;
+		uint32 N2 = _data >> 32;
+		uint32 S = ((uint64)N1 + key[_key_num]) % 0xffffffffULL;
+		uint32 tmp_res = 0;
+		for(uint8 i = 0; i < 8; i++)
+			tmp_res += (uint32)table[i][(S >> (i * 4)) & 0xf] << (i * 4);
+		S = (tmp_res >> 21) | (tmp_res << 11);
+		S ^= N2;
+		return ((uint64)N1 << 32) | S;
+	}
+
+	/*! Цикл зашифрования 32-З.
+	*/
+	uint64 cycle_32Z(uint64 _data) const
+	{
+		for(int i = 0; i < 3; i++)
+			for(int j = 0; j < 8; j++)
+				_data = mainStep(_data, j);
+		for(int j = 7; j >= 0; j--)
+			_data = mainStep(_data, j);
+		return (_data << 32) | (_data >> 32);
+	}
+
+	/*! Цикл расшифрования 32-Р.
+	*/
+	uint64 cycle_32R(uint64 _data) const
+	{
+		for(int j = 0; j < 8; j++)
+			_data = mainStep(_data, j);
+		for(int i = 0; i < 3; i++)
+			for(int j = 7; j >= 0; j--)
+				_data = mainStep(_data, j);
+		return (_data << 32) | (_data >> 32);
+	}
+
+	/*! Цикл выработки имитовставки 16-З.
+	*/
+	uint64 cycle_16Z(uint64 _data) const
+	{
+		for(int i = 0; i < 2; i++)
+			for(int j = 0; j < 8; j++)
+				_data = mainStep(_data, j);
+		return _data;
+	}
+
+	/*! Режим простой замены.
+	*/
+	bool simpleReplace(uint8 *_data, uint32 _size, bool _encoding) const
+	{
+		if(_size % 8 != 0)
+			return false;
+		for(uint32 i = 0; i < _size; i += 8)
+		{
+			uint64 block;
+			memcpy(&block, &_data[i], 8);
+			block = _encoding ? cycle_32Z(block) : cycle_32R(block);
+			memcpy(&_data[i], &block, 8);
+		}
+		return true;
+	}
+
+	/*! Режим гаммирования. Последний блок (в том числе полный) шифруется текущей гаммой
+		без изменения синхропосылки.
+	*/
+	bool gamming(uint8 *_data, uint32 _size, uint64 &S) const
+	{
+		S = cycle_32Z(S);
+		uint32 S0 = S & 0xffffffffULL;
+		uint32 S1 = S >> 32;
+		uint32 i;
+		uint64 block;
+		for(i = 0; i + 8 < _size; i += 8)
+		{
+			S0 = S0 + 0x1010101;
+			S1 = (uint32)(S1 + 0x1010104 - 1) % 0xffffffffULL + 1;
+			S = S0 | ((uint64)S1 << 32);
+			memcpy(&block, &_data[i], 8);
+			block ^= cycle_32Z(S);
+			memcpy(&_data[i], &block, 8);
+		}
+		if(i < _size)
+		{
+			block = 0;
+			memcpy(&block, &_data[i], _size - i);
+			block ^= cycle_32Z(S);
+			memcpy(&_data[i], &block, _size - i);
+		}
+		return true;
+	}
+
+	/*! Режим гаммирования с обратной связью. Последний блок (в том числе полный) не меняет
+		синхропосылку.
+	*/
+	bool gammingWF(uint8 *_data, uint32 _size, uint64 &S, bool _encoding) const
+	{
+		uint32 i;
+		uint64 block;
+		for(i = 0; i + 8 < _size; i += 8)
+		{
+			memcpy(&block, &_data[i], 8);
+			uint64 out = block ^ cycle_32Z(S);
+			memcpy(&_data[i], &out, 8);
+			S = _encoding ? out : block;
+		}
+		if(i < _size)
+		{
+			block = 0;
+			memcpy(&block, &_data[i], _size - i);
+			block ^= cycle_32Z(S);
+			memcpy(&_data[i], &block, _size - i);
+		}
+		return true;
+	}
+
+	/*! Выработка имитовставки.
+	*/
+	uint32 imiIns(const uint8 *_data, uint32 _size) const
+	{
+		uint64 S = 0, block;
+		uint32 i;
+		for(i = 0; i + 8 < _size; i += 8)
+		{
+			memcpy(&block, &_data[i], 8);
+			S = cycle_16Z(S ^ block);
+		}
+		if(i < _size)
+		{
+			block = 0;
+			memcpy(&block, &_data[i], _size - i);
+			S = cycle_16Z(S ^ block);
+		}
+		return S & 0xffffffffULL;
+	}
+
+	/*! Устанавливает ключ и таблицу замен эталона в объект библиотеки \e _cr.
+	*/
+	void setup(Cryptographer &_cr) const
+	{
+		uint32 k[8];
+		uint8 rows[8][16];
+		uint8 *rt[8];
+		memcpy(k, key, sizeof(k));
+		memcpy(rows, table, sizeof(rows));
+		for(int i = 0; i < 8; i++)
+			rt[i] = rows[i];
+		_cr.setKey(k);
+		_cr.setReplaceTable(rt);
+	}
+};
+
+//==========================================================================//
+
+/*! Эталонное кодирование по RFC 4648 без дополнения: биты данных от старших к младшим
+	разбиваются на группы по \e _bits битов, последняя группа дополняется нулями.
+	\param _src - исходные данные.
+	\param _size - размер \e _src в байтах.
+	\param _digits - алфавит из \f$ 2^{\_bits} \f$ символов.
+	\param _bits - количество битов на символ.
+	\param _dst - результат.
+	\returns Количество записанных символов.
+*/
+inline uint32 referenceEncode(const uint8 *_src, uint32 _size, const char *_digits, uint32 _bits, char *_dst)
+{
+	uint32 n = 0;
+	uint64 total = (uint64)_size * 8;
+	for(uint64 pos = 0; pos < total; pos += _bits, n++)
+	{
+		uint32 v = 0;
+		for(uint32 b = 0; b < _bits; b++)
+		{
+			uint64 p = pos + b;
+			uint32 bit = p < total ? (_src[p / 8] >> (7 - p % 8)) & 1 : 0;
+			v = (v << 1) | bit;
+		}
+		_dst[n] = _digits[v];
+	}
+	return n;
+}
+
+//==========================================================================//
+
+#endif
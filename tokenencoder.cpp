@@ -0,0 +1,504 @@
+
+#include <string.h>
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TOKEN_X86
+#endif
+
+#include "tokenencoder.h"
+
+/*! \class TokenEncoder
+	Кодирование двоичных данных в шестнадцатеричные цифры, base32 и base64url (RFC 4648,
+	без символов дополнения). Кодирование hex и base64url выполняется векторными инструкциями
+	SSSE3 или AVX2, если процессор их поддерживает; реализация выбирается при первом обращении
+	(тесты могут заменить её <em>setImplementation()</em>). Результат не завершается нулём.
+*/
+
+/*! \class TokenGen
+	Генератор случайных токенов: случайные байты запрашиваются у \e RandomGen крупными порциями
+	и кодируются \e TokenEncoder прямо в буфер вызывающей стороны.
+	\par Пример:
+	\code
+	// Токены из 16 случайных байтов (128 битов) в формате base64url - по 22 символа.
+	TokenGen tg(TokenEncoder::Base64Url, 16);
+	std::string token;
+	tg.nextToken(token);
+	char buf[100000 * 23];
+	tg.nextTokens(buf, 100000, 23);
+	\endcode
+*/
+
+//==========================================================================//
+
+static const char hexDigits[] = "0123456789abcdef";
+static const char base32Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+static const char base64UrlDigits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+typedef void (*EncodeFunc)(const uint8 *_src, uint32 _size, char *_dst);
+
+//==========================================================================//
+
+/*! Кодирование hex без векторных инструкций.
+*/
+static void hexScalar(const uint8 *_src, uint32 _size, char *_dst)
+{
+	for(uint32 i = 0; i < _size; i++)
+	{
+		*_dst++ = hexDigits[_src[i] >> 4];
+		*_dst++ = hexDigits[_src[i] & 0x0f];
+	}
+}
+
+//==========================================================================//
+
+/*! Кодирование base64url без векторных инструкций.
+*/
+static void base64UrlScalar(const uint8 *_src, uint32 _size, char *_dst)
+{
+	uint32 i = 0;
+	for(; i + 3 <= _size; i += 3)
+	{
+		uint32 x = (_src[i] << 16) | (_src[i + 1] << 8) | _src[i + 2];
+		*_dst++ = base64UrlDigits[x >> 18];
+		*_dst++ = base64UrlDigits[(x >> 12) & 0x3f];
+		*_dst++ = base64UrlDigits[(x >> 6) & 0x3f];
+		*_dst++ = base64UrlDigits[x & 0x3f];
+	}
+	if(_size - i == 1)
+	{
+		*_dst++ = base64UrlDigits[_src[i] >> 2];
+		*_dst++ = base64UrlDigits[(_src[i] & 0x03) << 4];
+	}
+	else if(_size - i == 2)
+	{
+		uint32 x = (_src[i] << 8) | _src[i + 1];
+		*_dst++ = base64UrlDigits[x >> 10];
+		*_dst++ = base64UrlDigits[(x >> 4) & 0x3f];
+		*_dst++ = base64UrlDigits[(x << 2) & 0x3f];
+	}
+}
+
+//==========================================================================//
+
+#ifdef TOKEN_X86
+
+/*! Кодирование hex с помощью SSSE3: полубайты 16 байтов заменяются цифрами одной командой
+	\e pshufb и чередуются командами распаковки.
+*/
+__attribute__((target("ssse3")))
+static void hexSSSE3(const uint8 *_src, uint32 _size, char *_dst)
+{
+	const __m128i lut = _mm_loadu_si128((const __m128i*)hexDigits);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	uint32 i = 0;
+	for(; i + 16 <= _size; i += 16, _dst += 32)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(_src + i));
+		__m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+		__m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(x, mask));
+		_mm_storeu_si128((__m128i*)_dst, _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i*)(_dst + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+	hexScalar(_src + i, _size - i, _dst);
+}
+
+//==========================================================================//
+
+/*! Кодирование hex с помощью AVX2 по 32 байта. Распаковка AVX2 работает внутри 128-битных
+	половин регистра, поэтому половины результата переставляются перед записью.
+*/
+__attribute__((target("avx2")))
+static void hexAVX2(const uint8 *_src, uint32 _size, char *_dst)
+{
+	const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)hexDigits));
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	uint32 i = 0;
+	for(; i + 32 <= _size; i += 32, _dst += 64)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i*)(_src + i));
+		__m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), mask));
+		__m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(x, mask));
+		__m256i a = _mm256_unpacklo_epi8(hi, lo);
+		__m256i b = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((__m256i*)_dst, _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((__m256i*)(_dst + 32), _mm256_permute2x128_si256(a, b, 0x31));
+	}
+	hexSSSE3(_src + i, _size - i, _dst);
+}
+
+//==========================================================================//
+
+/*! Кодирование base64url с помощью SSSE3 (метод Мулы): 12 байтов раскладываются по 16 байтам
+	командой \e pshufb, 6-битные индексы выделяются умножениями 16-битных слов, а символы
+	получаются прибавлением к индексам смещений из таблицы, выбираемых по диапазону индекса.
+	Читается 16 байтов на каждые 12 кодируемых, поэтому последние байты кодируются без SSSE3.
+*/
+__attribute__((target("ssse3")))
+static void base64UrlSSSE3(const uint8 *_src, uint32 _size, char *_dst)
+{
+	const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0);
+	uint32 i = 0;
+	for(; i + 16 <= _size; i += 12, _dst += 16)
+	{
+		__m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(_src + i)), spread);
+		__m128i t0 = _mm_mulhi_epu16(_mm_and_si128(x, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+		__m128i t1 = _mm_mullo_epi16(_mm_and_si128(x, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+		__m128i indices = _mm_or_si128(t0, t1);
+		__m128i r = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+		__m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+		r = _mm_or_si128(r, _mm_and_si128(less, _mm_set1_epi8(13)));
+		_mm_storeu_si128((__m128i*)_dst, _mm_add_epi8(_mm_shuffle_epi8(shift_lut, r), indices));
+	}
+	base64UrlScalar(_src + i, _size - i, _dst);
+}
+
+#endif
+
+//==========================================================================//
+
+//! Набор функций кодирования для одного набора инструкций.
+struct EncodeKernels
+{
+	const char *name;		//!< Имя набора инструкций.
+	EncodeFunc hex;			//!< Кодирование hex.
+	EncodeFunc base64url;	//!< Кодирование base64url.
+};
+
+//! Реализации в порядке предпочтения.
+static const EncodeKernels encodeKernels[] =
+{
+#ifdef TOKEN_X86
+	{"avx2", hexAVX2, base64UrlSSSE3},
+	{"ssse3", hexSSSE3, base64UrlSSSE3},
+#endif
+	{"scalar", hexScalar, base64UrlScalar}
+};
+
+const uint32 encodeKernelCount = sizeof(encodeKernels) / sizeof(encodeKernels[0]);	//!< Количество реализаций.
+
+//==========================================================================//
+
+/*! Проверка поддержки реализации процессором.
+*/
+static bool kernelSupported(const EncodeKernels &_k)
+{
+#ifdef TOKEN_X86
+	__builtin_cpu_init();
+	if(!strcmp(_k.name, "avx2"))
+		return __builtin_cpu_supports("avx2");
+	if(!strcmp(_k.name, "ssse3"))
+		return __builtin_cpu_supports("ssse3");
+#endif
+	return true;
+}
+
+//==========================================================================//
+
+/*! Выбор лучшей реализации, поддерживаемой процессором.
+*/
+static const EncodeKernels *selectKernels()
+{
+	for(uint32 i = 0; i + 1 < encodeKernelCount; i++)
+		if(kernelSupported(encodeKernels[i]))
+			return &encodeKernels[i];
+	return &encodeKernels[encodeKernelCount - 1];
+}
+
+//==========================================================================//
+
+/*! Текущая реализация, выбранная при первом обращении (в том числе из статических конструкторов)
+	или заданная <em>TokenEncoder::setImplementation()</em>.
+*/
+static std::atomic<const EncodeKernels*> &currentKernels()
+{
+	static std::atomic<const EncodeKernels*> current(selectKernels());
+	return current;
+}
+
+//==========================================================================//
+
+/*! Текущая реализация hex.
+*/
+static inline EncodeFunc hexImpl()
+{
+	return currentKernels().load(std::memory_order_relaxed)->hex;
+}
+
+//==========================================================================//
+
+/*! Текущая реализация base64url.
+*/
+static inline EncodeFunc base64UrlImpl()
+{
+	return currentKernels().load(std::memory_order_relaxed)->base64url;
+}
+
+//==========================================================================//
+
+/*! Длина кодированных данных в символах.
+	\param _format - формат.
+	\param _size - размер исходных данных в байтах.
+	\returns Количество символов.
+*/
+uint32 TokenEncoder::encodedLength(Format _format, uint32 _size)
+{
+	switch(_format)
+	{
+	case Hex:
+		return _size * 2;
+	case Base32:
+		return ((uint64)_size * 8 + 4) / 5;
+	default:
+		return ((uint64)_size * 4 + 2) / 3;
+	}
+}
+
+//==========================================================================//
+
+/*! Размер группы байтов, которая кодируется целым числом символов. Данные, состоящие
+	из целого числа групп, можно кодировать по частям и склеивать результаты.
+	\param _format - формат.
+	\returns Размер группы в байтах.
+*/
+uint32 TokenEncoder::groupSize(Format _format)
+{
+	switch(_format)
+	{
+	case Hex:
+		return 1;
+	case Base32:
+		return 5;
+	default:
+		return 3;
+	}
+}
+
+//==========================================================================//
+
+/*! Кодирование данных в заданном формате.
+	\param _format - формат.
+	\param _src - исходные данные.
+	\param _size - размер \e _src в байтах.
+	\param _dst - массив не менее чем из <em>encodedLength(_format, _size)</em> символов.
+*/
+void TokenEncoder::encode(Format _format, const uint8 *_src, uint32 _size, char *_dst)
+{
+	switch(_format)
+	{
+	case Hex:
+		hexImpl()(_src, _size, _dst);
+		break;
+	case Base32:
+		encodeBase32(_src, _size, _dst);
+		break;
+	default:
+		base64UrlImpl()(_src, _size, _dst);
+		break;
+	}
+}
+
+//==========================================================================//
+
+/*! Кодирование данных шестнадцатеричными цифрами (строчные буквы).
+	\param _src - исходные данные.
+	\param _size - размер \e _src в байтах.
+	\param _dst - массив не менее чем из <em>2 * _size</em> символов.
+*/
+void TokenEncoder::encodeHex(const uint8 *_src, uint32 _size, char *_dst)
+{
+	hexImpl()(_src, _size, _dst);
+}
+
+//==========================================================================//
+
+/*! Кодирование данных в base32 без дополнения. Векторная реализация не используется:
+	группы по 5 байтов кодируются через одно 64-битное слово.
+	\param _src - исходные данные.
+	\param _size - размер \e _src в байтах.
+	\param _dst - массив не менее чем из <em>encodedLength(Base32, _size)</em> символов.
+*/
+void TokenEncoder::encodeBase32(const uint8 *_src, uint32 _size, char *_dst)
+{
+	uint32 i = 0;
+	for(; i + 5 <= _size; i += 5)
+	{
+		uint64 x = ((uint64)_src[i] << 32) | ((uint64)_src[i + 1] << 24) | ((uint64)_src[i + 2] << 16) |
+			((uint64)_src[i + 3] << 8) | _src[i + 4];
+		for(int s = 35; s >= 0; s -= 5)
+			*_dst++ = base32Digits[(x >> s) & 0x1f];
+	}
+	uint64 bits = 0;
+	uint32 n = 0;
+	for(; i < _size; i++)
+	{
+		bits = (bits << 8) | _src[i];
+		n += 8;
+		while(n >= 5)
+		{
+			n -= 5;
+			*_dst++ = base32Digits[(bits >> n) & 0x1f];
+		}
+	}
+	if(n)
+		*_dst++ = base32Digits[(bits << (5 - n)) & 0x1f];
+}
+
+//==========================================================================//
+
+/*! Кодирование данных в base64url без дополнения.
+	\param _src - исходные данные.
+	\param _size - размер \e _src в байтах.
+	\param _dst - массив не менее чем из <em>encodedLength(Base64Url, _size)</em> символов.
+*/
+void TokenEncoder::encodeBase64Url(const uint8 *_src, uint32 _size, char *_dst)
+{
+	base64UrlImpl()(_src, _size, _dst);
+}
+
+//==========================================================================//
+
+/*! Набор инструкций, используемый для кодирования.
+	\returns "avx2", "ssse3" или "scalar".
+*/
+const char *TokenEncoder::implementation()
+{
+	return currentKernels().load(std::memory_order_relaxed)->name;
+}
+
+//==========================================================================//
+
+/*! Проверка, поддерживает ли процессор реализацию \e _name.
+	\param _name - "avx2", "ssse3" или "scalar".
+	\returns \b true, если реализация собрана и поддерживается процессором.
+*/
+bool TokenEncoder::supports(const char *_name)
+{
+	for(uint32 i = 0; i < encodeKernelCount; i++)
+		if(!strcmp(encodeKernels[i].name, _name))
+			return kernelSupported(encodeKernels[i]);
+	return false;
+}
+
+//==========================================================================//
+
+/*! Выбор реализации кодирования hex и base64url (для тестов и измерений). Вызов не
+	синхронизирован с кодированием в других потоках: они могут ещё некоторое время
+	использовать прежнюю реализацию.
+	\param _name - "avx2", "ssse3" или "scalar".
+	\returns \b true в случае успеха, \b false - если реализация не поддерживается.
+*/
+bool TokenEncoder::setImplementation(const char *_name)
+{
+	for(uint32 i = 0; i < encodeKernelCount; i++)
+		if(!strcmp(encodeKernels[i].name, _name) && kernelSupported(encodeKernels[i]))
+		{
+			currentKernels().store(&encodeKernels[i], std::memory_order_relaxed);
+			return true;
+		}
+	return false;
+}
+
+//==========================================================================//
+
+/*! Создаёт генератор токенов. Производится инициализация генератора случайных чисел \e rg
+	с параметрами \e _seq_size и \e _test_windows (см. <em>RandomGen::RandomGen()</em>).
+	\param _format - формат токенов.
+	\param _token_bytes - количество случайных байтов в токене.
+	\param _seq_size - размер последовательности \e RandomGen.
+	\param _test_windows - количество тестируемых окон \e RandomGen.
+*/
+TokenGen::TokenGen(TokenEncoder::Format _format, uint32 _token_bytes, uint32 _seq_size, uint32 _test_windows) :
+	rg(_seq_size, _test_windows), format(_format), token_bytes(_token_bytes)
+{
+	rg.init();
+}
+
+//==========================================================================//
+
+/*! Длина токена в символах.
+*/
+uint32 TokenGen::tokenLength() const
+{
+	return TokenEncoder::encodedLength(format, token_bytes);
+}
+
+//==========================================================================//
+
+/*! Генерирует токен в строку \e _res. Память строки используется повторно.
+	\param _res - строка для результата.
+*/
+void TokenGen::nextToken(std::string &_res)
+{
+	_res.resize(tokenLength());
+	if(!_res.empty())
+		nextTokens(&_res[0], 1, _res.size());
+}
+
+//==========================================================================//
+
+/*! Генерирует \e _count токенов в буфер \e _buf. Токен с номером \e i записывается по адресу
+	<em>_buf + i * _stride</em>. Если \e _stride больше длины токена, после каждого токена
+	записывается завершающий ноль. Если токены записываются подряд и состоят из целого числа
+	групп формата, вся порция случайных байтов кодируется одним вызовом.
+	\param _buf - буфер размером не менее <em>_count * _stride</em> байтов.
+	\param _count - количество токенов.
+	\param _stride - шаг размещения токенов в буфере.
+	\returns \b true в случае успеха, \b false - если \e _stride меньше длины токена.
+*/
+bool TokenGen::nextTokens(char *_buf, uint32 _count, uint32 _stride)
+{
+	const uint32 len = tokenLength();
+	if(_stride < len)
+		return false;
+	if(!token_bytes)
+	{
+		for(uint32 i = 0; i < _count && _stride; i++)
+			_buf[i * _stride] = 0;
+		return true;
+	}
+	uint32 per_chunk = token_bytes < chunkSize ? chunkSize / token_bytes : 1;
+	if(_count < per_chunk)
+		per_chunk = _count;
+	const uint64 used = (uint64)per_chunk * token_bytes;
+	if(raw.size() < used)
+		raw.resize(used);
+	const bool whole = _stride == len && token_bytes % TokenEncoder::groupSize(format) == 0;
+	while(_count)
+	{
+		uint32 n = _count < per_chunk ? _count : per_chunk;
+		rg.nextBytes(&raw[0], n * token_bytes);
+		if(whole)
+		{
+			TokenEncoder::encode(format, &raw[0], n * token_bytes, _buf);
+			_buf += (uint64)n * len;
+		}
+		else
+			for(uint32 i = 0; i < n; i++, _buf += _stride)
+			{
+				TokenEncoder::encode(format, &raw[i * token_bytes], token_bytes, _buf);
+				if(_stride > len)
+					_buf[len] = 0;
+			}
+		_count -= n;
+	}
+	if(used)
+		memset(&raw[0], 0, used);
+	return true;
+}
+
+//==========================================================================//
+
+/*! Освобождает порцию случайных байтов и последовательность генератора \e rg.
+*/
+void TokenGen::compact()
+{
+	std::vector<uint8>().swap(raw);
+	rg.compact();
+}
+
+//==========================================================================//
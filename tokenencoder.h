@@ -0,0 +1,59 @@
+
+#ifndef _TOKENENCODER_H_
+#define _TOKENENCODER_H_
+
+#include <string>
+#include <vector>
+
+#include "randomgen.h"
+
+//==========================================================================//
+
+//! Класс кодирования двоичных данных в текстовые токены.
+class TokenEncoder
+{
+public:
+	//! Форматы токенов.
+	enum Format
+	{
+		Hex,		//!< Шестнадцатеричные цифры (2 символа на байт).
+		Base32,		//!< base32 по RFC 4648 без дополнения (8 символов на 5 байтов).
+		Base64Url	//!< base64url по RFC 4648 без дополнения (4 символа на 3 байта).
+	};
+
+	static uint32 encodedLength(Format _format, uint32 _size);	//!< Длина кодированных данных.
+	static uint32 groupSize(Format _format);		//!< Размер группы байтов, кодируемой целым числом символов.
+	static void encode(Format _format, const uint8 *_src, uint32 _size, char *_dst);	//!< Кодирование.
+	static void encodeHex(const uint8 *_src, uint32 _size, char *_dst);		//!< Кодирование hex.
+	static void encodeBase32(const uint8 *_src, uint32 _size, char *_dst);		//!< Кодирование base32.
+	static void encodeBase64Url(const uint8 *_src, uint32 _size, char *_dst);	//!< Кодирование base64url.
+	static const char *implementation();			//!< Используемый набор инструкций.
+	static bool supports(const char *_name);		//!< Поддержка реализации процессором.
+	static bool setImplementation(const char *_name);	//!< Выбор реализации (для тестов).
+};
+
+//==========================================================================//
+
+//! Класс генератора случайных токенов.
+class TokenGen
+{
+private:
+	static const uint32 chunkSize = 65536;			//!< Размер порции случайных байтов.
+
+	RandomGen rg;									//!< Генератор случайных чисел.
+	TokenEncoder::Format format;					//!< Формат токенов.
+	uint32 token_bytes;								//!< Количество случайных байтов в токене.
+	std::vector<uint8> raw;							//!< Порция случайных байтов.
+
+public:
+	TokenGen(TokenEncoder::Format _format, uint32 _token_bytes, uint32 _seq_size = fipsBlockSize, uint32 _test_windows = 0);	//!< Конструктор.
+
+	uint32 tokenLength() const;						//!< Длина токена в символах.
+	void nextToken(std::string &_res);				//!< Генерация токена в строку \e _res.
+	bool nextTokens(char *_buf, uint32 _count, uint32 _stride);	//!< Генерация \e _count токенов в буфер \e _buf.
+	void compact();									//!< Освобождение буферов на время простоя.
+};
+
+//==========================================================================//
+
+#endif
@@ -0,0 +1,913 @@
+
+/*! \file cryptonbench.cpp
+	Утилита \e crypton-bench измеряет производительность режимов \e Cryptographer (простая замена,
+	гаммирование, гаммирование с обратной связью - зашифрование и расшифрование, выработка
+	имитовставки), методов \e RandomGen (<em>nextInt8/32/64()</em>, <em>nextBytes()</em>) и
+	<em>PasswordGen::nextPassword()</em>. Методы \e RandomGen измеряются в рабочем режиме
+	(<em>init()</em>, обновление последовательности из <b>/dev/urandom</b>) и, под именами
+	с суффиксом \b .deterministic, в детерминированном (<em>initDeterministic()</em>). Каждое измерение выполняется для ряда размеров сообщения
+	(от 8 байтов, с шагом x8, до \e -m) и количеств потоков (1, 2, 4, ... до \e -t). Каждый поток
+	работает со своим объектом и своим буфером.
+	\par
+	Для каждого измерения выводится одна строка JSON: скорость (МиБ/с), такты на байт
+	(по счётчику TSC), среднее время операции и её медианная и 99-процентная задержки
+	в наносекундах. Скорость, такты и аппаратные счётчики измеряются по циклу операций без
+	замеров отдельных операций. Задержки измеряются после него, на выборке операций
+	всех потоков (1/\e latencySampling от их количества).
+	\par
+	С ключом \e -c в каждом потоке через <em>perf_event_open()</em> считываются аппаратные счётчики
+	(такты, инструкции, промахи L1D и LLC при чтении, ошибки предсказания переходов, только
+	пользовательский режим); в результат добавляются их значения на одну операцию и количество
+	инструкций за такт. Счётчики, недоступные в системе (нет PMU, запрет
+	<em>perf_event_paranoid</em>, контейнер), выводятся как \b null.
+	\par
+	С ключом \e -r каждое измерение повторяется заданное количество раз; выводится результат
+	повтора с медианной скоростью и медианное абсолютное отклонение (MAD) скорости. По умолчанию
+	измерение выполняется один раз, а при сохранении результатов (\e -o) и сравнении (\e -b) -
+	пять раз. Результаты, сохранённые ключом \e -o, можно использовать как базовые (\e -b), если
+	каждое измерение в них повторялось не менее трёх раз (иначе MAD не оценивает разброс,
+	и сравнение отвергается). Каждое измерение
+	сравнивается с базовым для той же операции, размера сообщения и количества потоков.
+	Замедление считается регрессией, если оно превышает порог \e -x (в процентах) и
+	статистически значимо: разность медиан больше трёх стандартных отклонений, оценённых по MAD
+	обоих наборов. Регрессии перечисляются в потоке ошибок по операциям и размерам сообщения,
+	и утилита завершается с кодом \b 1.
+	\par Использование:
+	\code
+	crypton-bench [-m max_size] [-t threads] [-d seconds] [-f filter] [-o file] [-c] [-r trials]
+		[-b baseline] [-x threshold]
+	\endcode
+	Размеры можно указывать с суффиксами \b K, \b M и \b G.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cryptographer.h"
+#include "randomgen.h"
+#include "passwordgen.h"
+#include "toolutil.h"
+
+//==========================================================================//
+
+//! Измеряемые операции.
+enum BenchId
+{
+	SimpleReplaceEnc,	//!< Простая замена, зашифрование.
+	SimpleReplaceDec,	//!< Простая замена, расшифрование.
+	Gamming,			//!< Гаммирование.
+	GammingWFEnc,		//!< Гаммирование с обратной связью, зашифрование.
+	GammingWFDec,		//!< Гаммирование с обратной связью, расшифрование.
+	ImiIns,				//!< Выработка имитовставки.
+	RandInt8,			//!< <em>RandomGen::nextInt8()</em>.
+	RandInt32,			//!< <em>RandomGen::nextInt32()</em>.
+	RandInt64,			//!< <em>RandomGen::nextInt64()</em>.
+	RandBytes,			//!< <em>RandomGen::nextBytes()</em>.
+	RandInt8Det,		//!< <em>RandomGen::nextInt8()</em>, детерминированный режим.
+	RandInt32Det,		//!< <em>RandomGen::nextInt32()</em>, детерминированный режим.
+	RandInt64Det,		//!< <em>RandomGen::nextInt64()</em>, детерминированный режим.
+	RandBytesDet,		//!< <em>RandomGen::nextBytes()</em>, детерминированный режим.
+	Password,			//!< <em>PasswordGen::nextPassword()</em>.
+	BenchCount			//!< Количество операций.
+};
+
+//! Описание измеряемой операции.
+struct BenchInfo
+{
+	const char *name;	//!< Имя операции.
+	uint32 fixed_size;	//!< Размер операции в байтах (\b 0 - перебираются размеры сообщения).
+	uint64 max_size;	//!< Максимальный размер сообщения (\b 0 - не ограничен).
+};
+
+static const BenchInfo benches[BenchCount] =
+{
+	{"simpleReplace.enc", 0, 0},
+	{"simpleReplace.dec", 0, 0},
+	{"gamming", 0, 0},
+	{"gammingWF.enc", 0, 0},
+	{"gammingWF.dec", 0, 0},
+	{"imiIns", 0, 0},
+	{"RandomGen.nextInt8", 1, 0},
+	{"RandomGen.nextInt32", 4, 0},
+	{"RandomGen.nextInt64", 8, 0},
+	{"RandomGen.nextBytes", 0, 0},
+	{"RandomGen.nextInt8.deterministic", 1, 0},
+	{"RandomGen.nextInt32.deterministic", 4, 0},
+	{"RandomGen.nextInt64.deterministic", 8, 0},
+	{"RandomGen.nextBytes.deterministic", 0, 0},
+	{"PasswordGen.nextPassword", 0, 4096}
+};
+
+//! Аппаратные счётчики.
+enum CounterId
+{
+	CounterCycles,			//!< Такты процессора.
+	CounterInstructions,	//!< Выполненные инструкции.
+	CounterL1DMisses,		//!< Промахи L1D при чтении.
+	CounterLLCMisses,		//!< Промахи кэша последнего уровня при чтении.
+	CounterBranchMisses,	//!< Ошибки предсказания переходов.
+	CounterCount			//!< Количество счётчиков.
+};
+
+//! Описание аппаратного счётчика.
+struct CounterInfo
+{
+	const char *name;		//!< Имя поля результата (значение на одну операцию).
+	uint32 type;			//!< Тип события <em>perf_event_open()</em>.
+	uint64 config;			//!< Событие.
+};
+
+#ifdef __linux__
+static const CounterInfo counters[CounterCount] =
+{
+	{"cycles_per_op", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{"instructions_per_op", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{"l1d_misses_per_op", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		(PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+	{"llc_misses_per_op", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		(PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+	{"branch_misses_per_op", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+};
+#else
+static const CounterInfo counters[CounterCount] =
+{
+	{"cycles_per_op", 0, 0},
+	{"instructions_per_op", 0, 0},
+	{"l1d_misses_per_op", 0, 0},
+	{"llc_misses_per_op", 0, 0},
+	{"branch_misses_per_op", 0, 0}
+};
+#endif
+
+//! Параметры работы утилиты.
+struct Options
+{
+	uint64 max_size;		//!< Максимальный размер сообщения.
+	uint32 threads;			//!< Максимальное количество потоков.
+	double duration;		//!< Минимальная длительность одного измерения в секундах.
+	const char *filter;		//!< Подстрока имени измеряемых операций (\b NULL - все).
+	const char *output;		//!< Имя файла результатов (\b NULL - стандартный вывод).
+	bool counters;			//!< Считывать аппаратные счётчики.
+	uint32 trials;			//!< Количество повторов каждого измерения.
+	const char *baseline;	//!< Имя файла базовых результатов (\b NULL - без сравнения).
+	double threshold;		//!< Порог регрессии (доля замедления).
+};
+
+//! Состояние одного потока измерения.
+struct ThreadCtx
+{
+	Cryptographer cr;		//!< Криптографический модуль.
+	RandomGen *rg;			//!< Генератор случайных чисел (рабочий режим).
+	RandomGen *seeded_rg;	//!< Генератор случайных чисел (детерминированный режим).
+	PasswordGen *pg;		//!< Генератор паролей.
+	std::vector<uint8> buf;	//!< Буфер сообщения.
+	std::string password;	//!< Строка для паролей.
+	uint64 S;				//!< Синхропосылка.
+	uint64 sink;			//!< Накопитель результатов (чтобы вызовы не были удалены компилятором).
+	uint64 ops;				//!< Количество выполненных операций.
+	uint64 total_ticks;		//!< Количество тактов TSC за время измерения скорости.
+	double seconds;			//!< Длительность измерения скорости.
+	std::vector<uint64> latencies;	//!< Задержки выборки операций в тактах TSC.
+	int counter_fds[CounterCount];	//!< Дескрипторы аппаратных счётчиков потока (\b -1 - счётчик недоступен).
+	double counts[CounterCount];	//!< Значения счётчиков за измерение (\b -1 - счётчик недоступен).
+};
+
+//! Результат одного измерения.
+struct Result
+{
+	uint64 ops;				//!< Количество операций во всех потоках.
+	uint64 bytes;			//!< Количество обработанных байтов.
+	double seconds;			//!< Длительность измерения.
+	double ticks;			//!< Суммарное количество тактов TSC измерения скорости всех потоков.
+	double p50;				//!< Медианная задержка операции в наносекундах.
+	double p99;				//!< 99-процентная задержка операции в наносекундах.
+	double counts[CounterCount];	//!< Суммы счётчиков всех потоков (\b -1 - счётчик недоступен).
+	uint32 trials;			//!< Количество повторов измерения.
+	double mad;				//!< Медианное абсолютное отклонение скорости по повторам (МиБ/с).
+};
+
+//! Базовый результат измерения.
+struct Baseline
+{
+	std::string bench;		//!< Имя операции.
+	uint32 size;			//!< Размер сообщения.
+	uint32 threads;			//!< Количество потоков.
+	double mib_per_s;		//!< Скорость (МиБ/с).
+	double mad;				//!< Медианное абсолютное отклонение скорости.
+	uint32 trials;			//!< Количество повторов измерения.
+};
+
+//! Сравнение измерения с базовым.
+struct Comparison
+{
+	const Baseline *base;	//!< Базовый результат (\b NULL - отсутствует).
+	double change;			//!< Относительное изменение скорости.
+	bool regression;		//!< Значимое замедление больше порога.
+};
+
+const uint32 maxLatencySamples = 1 << 16;	//!< Максимальное количество измеряемых задержек в потоке.
+const uint32 latencySampling = 8;			//!< Задержки измеряются для 1/8 количества операций потока.
+const uint32 batchBytes = 65536;			//!< Объём операций между проверками времени.
+const uint64 maxTotalMemory = 1ULL << 32;	//!< Максимальный суммарный размер буферов потоков.
+const double madToSigma = 1.4826;			//!< Отношение стандартного отклонения к MAD для нормального распределения.
+const double significanceSigmas = 3.;		//!< Значимое изменение в стандартных отклонениях.
+const uint32 defaultTrials = 5;				//!< Количество повторов при сохранении и сравнении результатов.
+const uint32 minBaselineTrials = 3;			//!< Минимальное количество повторов базового измерения.
+
+static double ticks_per_ns = 1.;			//!< Частота счётчика TSC.
+static volatile uint64 sink;				//!< Сумма накопителей потоков.
+
+//==========================================================================//
+
+/*! Текущее время в секундах.
+*/
+static double now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//==========================================================================//
+
+/*! Значение счётчика тактов (TSC), на других архитектурах - время в наносекундах.
+*/
+static inline uint64 ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+//==========================================================================//
+
+/*! Определение частоты счётчика тактов.
+*/
+static void calibrateTicks()
+{
+	double t0 = now();
+	uint64 c0 = ticks();
+	while(now() - t0 < 0.05);
+	double t1 = now();
+	uint64 c1 = ticks();
+	ticks_per_ns = (c1 - c0) / ((t1 - t0) * 1e9);
+}
+
+//==========================================================================//
+
+/*! Находит значение поля \e _key в строке JSON с плоским объектом (в таком виде результаты
+	выводит сама утилита).
+	\param _line - строка JSON.
+	\param _key - имя поля.
+	\returns Указатель на начало значения или \b NULL, если поля нет.
+*/
+static const char *jsonField(const char *_line, const char *_key)
+{
+	std::string pattern = std::string("\"") + _key + "\":";
+	const char *p = strstr(_line, pattern.c_str());
+	return p ? p + pattern.size() : NULL;
+}
+
+//==========================================================================//
+
+/*! Чтение числового поля JSON.
+	\param _line - строка JSON.
+	\param _key - имя поля.
+	\param _res - значение (не меняется, если поле отсутствует или равно \b null).
+	\returns \b true, если поле прочитано.
+*/
+static bool jsonNumber(const char *_line, const char *_key, double &_res)
+{
+	const char *p = jsonField(_line, _key);
+	if(!p)
+		return false;
+	char *end = NULL;
+	double v = strtod(p, &end);
+	if(end == p)
+		return false;
+	_res = v;
+	return true;
+}
+
+//==========================================================================//
+
+/*! Загрузка базовых результатов: строк JSON, сохранённых ключом \e -o. Строки без полей
+	\e bench, \e size, \e threads и \e mib_per_s пропускаются. Результаты, измеренные менее
+	\e minBaselineTrials раз (или без поля \e trials), отвергаются: их MAD равно нулю или
+	не оценивает разброс, и любое замедление выше порога считалось бы значимым.
+	\param _file - имя файла.
+	\param _res - базовые результаты.
+	\returns \b true в случае успеха, \b false - если файл не читается, не содержит результатов
+	или содержит результаты со слишком малым количеством повторов.
+*/
+static bool loadBaseline(const char *_file, std::vector<Baseline> &_res)
+{
+	FILE *f = fopen(_file, "r");
+	if(!f)
+	{
+		fprintf(stderr, "%s open error: %s\n", _file, strerror(errno));
+		return false;
+	}
+	char line[4096];
+	while(fgets(line, sizeof(line), f))
+	{
+		Baseline b;
+		double size, threads;
+		const char *name = jsonField(line, "bench");
+		const char *name_end = name && *name == '"' ? strchr(name + 1, '"') : NULL;
+		if(!name_end || !jsonNumber(line, "size", size) || !jsonNumber(line, "threads", threads) ||
+			!jsonNumber(line, "mib_per_s", b.mib_per_s))
+			continue;
+		b.bench.assign(name + 1, name_end);
+		b.size = size;
+		b.threads = threads;
+		b.mad = 0;
+		jsonNumber(line, "mib_per_s_mad", b.mad);
+		double trials = 1;
+		jsonNumber(line, "trials", trials);
+		b.trials = trials;
+		_res.push_back(b);
+	}
+	bool ok = !ferror(f);
+	uint32 few = 0;
+	for(uint32 i = 0; i < _res.size(); i++)
+		if(_res[i].trials < minBaselineTrials)
+			few++;
+	if(!ok)
+		fprintf(stderr, "%s read error: %s\n", _file, strerror(errno));
+	else if(few)
+	{
+		fprintf(stderr, "%s: %u of %u results measured with fewer than %u trials, record the baseline with -r %u\n",
+			_file, few, (uint32)_res.size(), minBaselineTrials, defaultTrials);
+		ok = false;
+	}
+	else if(_res.empty())
+		fprintf(stderr, "%s: no results\n", _file);
+	fclose(f);
+	return ok && !_res.empty();
+}
+
+//==========================================================================//
+
+/*! Скорость измерения в МиБ/с.
+*/
+static double throughput(const Result &_res)
+{
+	return _res.seconds > 0 ? _res.bytes / _res.seconds / (1 << 20) : 0.;
+}
+
+//==========================================================================//
+
+/*! Сводка повторов измерения: результат повтора с медианной скоростью и MAD скорости.
+	\param _trials - результаты повторов.
+	\returns Сводный результат.
+*/
+static Result summarize(const std::vector<Result> &_trials)
+{
+	std::vector<double> speeds, deviations;
+	for(uint32 i = 0; i < _trials.size(); i++)
+		speeds.push_back(throughput(_trials[i]));
+	std::sort(speeds.begin(), speeds.end());
+	// При чётном количестве повторов берётся нижняя медиана - скорость одного из повторов.
+	double median = speeds[(speeds.size() - 1) / 2];
+	for(uint32 i = 0; i < speeds.size(); i++)
+		deviations.push_back(fabs(speeds[i] - median));
+	std::sort(deviations.begin(), deviations.end());
+	double mad = deviations[(deviations.size() - 1) / 2];
+
+	// Остальные поля выводятся по медианному повтору.
+	uint32 best = 0;
+	while(throughput(_trials[best]) != median)
+		best++;
+	Result res = _trials[best];
+	res.trials = _trials.size();
+	res.mad = mad;
+	return res;
+}
+
+//==========================================================================//
+
+/*! Сравнение измерения с базовым.
+	\param _base - базовые результаты.
+	\param _id - операция.
+	\param _size - размер сообщения.
+	\param _threads - количество потоков.
+	\param _res - результат измерения.
+	\param _threshold - порог регрессии (доля замедления).
+	\returns Результат сравнения.
+*/
+static Comparison compare(const std::vector<Baseline> &_base, BenchId _id, uint32 _size, uint32 _threads,
+	const Result &_res, double _threshold)
+{
+	Comparison cmp;
+	cmp.base = NULL;
+	cmp.change = 0;
+	cmp.regression = false;
+	for(uint32 i = 0; i < _base.size() && !cmp.base; i++)
+		if(_base[i].bench == benches[_id].name && _base[i].size == _size && _base[i].threads == _threads)
+			cmp.base = &_base[i];
+	if(!cmp.base || cmp.base->mib_per_s <= 0)
+	{
+		cmp.base = NULL;
+		return cmp;
+	}
+	double speed = throughput(_res);
+	double diff = cmp.base->mib_per_s - speed;
+	double sigma = madToSigma * sqrt(_res.mad * _res.mad + cmp.base->mad * cmp.base->mad);
+	cmp.change = -diff / cmp.base->mib_per_s;
+	cmp.regression = -cmp.change > _threshold && diff > significanceSigmas * sigma;
+	return cmp;
+}
+
+//==========================================================================//
+
+/*! Открывает аппаратные счётчики для вызывающего потока (в выключенном состоянии).
+	\param _fds - дескрипторы счётчиков; для недоступных счётчиков записывается \b -1.
+	\returns Количество открытых счётчиков.
+*/
+static uint32 openCounters(int *_fds)
+{
+	uint32 res = 0;
+	for(uint32 i = 0; i < CounterCount; i++)
+	{
+		_fds[i] = -1;
+#ifdef __linux__
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = counters[i].type;
+		attr.config = counters[i].config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		_fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+		if(_fds[i] >= 0)
+			res++;
+#else
+		errno = ENOSYS;
+#endif
+	}
+	return res;
+}
+
+//==========================================================================//
+
+/*! Обнуляет и включает счётчики.
+	\param _fds - дескрипторы счётчиков.
+*/
+static void startCounters(const int *_fds)
+{
+#ifdef __linux__
+	for(uint32 i = 0; i < CounterCount; i++)
+		if(_fds[i] >= 0)
+		{
+			ioctl(_fds[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+}
+
+//==========================================================================//
+
+/*! Выключает счётчики, считывает и закрывает их. Если ядро мультиплексировало счётчики
+	(их больше, чем регистров PMU), значение масштабируется на время работы счётчика.
+	\param _fds - дескрипторы счётчиков; на выходе \b -1.
+	\param _counts - значения счётчиков (\b -1 - счётчик недоступен).
+*/
+static void stopCounters(int *_fds, double *_counts)
+{
+#ifdef __linux__
+	for(uint32 i = 0; i < CounterCount; i++)
+		if(_fds[i] >= 0)
+			ioctl(_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+#endif
+	for(uint32 i = 0; i < CounterCount; i++)
+	{
+		_counts[i] = -1;
+		if(_fds[i] < 0)
+			continue;
+		uint64 v[3];	// Значение, время включения, время работы.
+		if(read(_fds[i], v, sizeof(v)) == sizeof(v) && v[2])
+			_counts[i] = v[2] < v[1] ? (double)v[0] * v[1] / v[2] : v[0];
+		close(_fds[i]);
+		_fds[i] = -1;
+	}
+}
+
+//==========================================================================//
+
+/*! Выполнение одной операции.
+	\param _id - операция.
+	\param _ctx - состояние потока.
+	\param _size - размер сообщения.
+*/
+static inline void runOp(BenchId _id, ThreadCtx &_ctx, uint32 _size)
+{
+	uint8 *data = _ctx.buf.empty() ? NULL : &_ctx.buf[0];
+	switch(_id)
+	{
+	case SimpleReplaceEnc:
+		_ctx.cr.simpleReplace(data, _size, true);
+		break;
+	case SimpleReplaceDec:
+		_ctx.cr.simpleReplace(data, _size, false);
+		break;
+	case Gamming:
+		_ctx.cr.gamming(data, _size, _ctx.S);
+		break;
+	case GammingWFEnc:
+		_ctx.cr.gammingWF(data, _size, _ctx.S, true);
+		break;
+	case GammingWFDec:
+		_ctx.cr.gammingWF(data, _size, _ctx.S, false);
+		break;
+	case ImiIns:
+		_ctx.sink += _ctx.cr.imiIns(data, _size);
+		break;
+	case RandInt8:
+		_ctx.sink += _ctx.rg->nextInt8();
+		break;
+	case RandInt32:
+		_ctx.sink += _ctx.rg->nextInt32();
+		break;
+	case RandInt64:
+		_ctx.sink += _ctx.rg->nextInt64();
+		break;
+	case RandBytes:
+		_ctx.rg->nextBytes(data, _size);
+		break;
+	case RandInt8Det:
+		_ctx.sink += _ctx.seeded_rg->nextInt8();
+		break;
+	case RandInt32Det:
+		_ctx.sink += _ctx.seeded_rg->nextInt32();
+		break;
+	case RandInt64Det:
+		_ctx.sink += _ctx.seeded_rg->nextInt64();
+		break;
+	case RandBytesDet:
+		_ctx.seeded_rg->nextBytes(data, _size);
+		break;
+	default:
+		_ctx.pg->nextPassword(_ctx.password, _size);
+		_ctx.sink += _ctx.password[0];
+		break;
+	}
+}
+
+//==========================================================================//
+
+/*! Функция потока измерения. Сначала операция выполняется пакетами до истечения \e _duration
+	секунд (не менее одного раза); время и аппаратные счётчики считываются только на границах
+	этого цикла, а окончание проверяется по счётчику тактов раз в \e batchBytes байтов. Затем
+	вне окна измерения скорости и счётчиков замеряются задержки отдельных операций: их количество
+	равно 1/\e latencySampling от выполненных (не более \e maxLatencySamples).
+	\param _id - операция.
+	\param _ctx - состояние потока.
+	\param _size - размер сообщения.
+	\param _duration - длительность измерения.
+	\param _start - флаг одновременного начала измерения.
+	\param _counters - считывать аппаратные счётчики.
+*/
+static void worker(BenchId _id, ThreadCtx *_ctx, uint32 _size, double _duration, const std::atomic<bool> *_start, bool _counters)
+{
+	for(uint32 i = 0; i < CounterCount; i++)
+		_ctx->counter_fds[i] = -1;
+	if(_counters)
+		openCounters(_ctx->counter_fds);
+	uint32 op_size = benches[_id].fixed_size ? benches[_id].fixed_size : _size;
+	uint32 batch = op_size < batchBytes ? batchBytes / op_size : 1;
+	uint64 ops = 0;
+	while(!_start->load(std::memory_order_acquire));
+
+	startCounters(_ctx->counter_fds);
+	double t0 = now();
+	uint64 start = ticks(), end = start + (uint64)(_duration * 1e9 * ticks_per_ns), t;
+	do
+	{
+		for(uint32 i = 0; i < batch; i++)
+			runOp(_id, *_ctx, _size);
+		ops += batch;
+	}
+	while((t = ticks()) < end);
+	stopCounters(_ctx->counter_fds, _ctx->counts);
+	_ctx->seconds = now() - t0;
+	_ctx->total_ticks = t - start;
+	_ctx->ops = ops;
+
+	_ctx->latencies.clear();
+	uint64 samples = std::min<uint64>(std::max<uint64>(ops / latencySampling, 1), maxLatencySamples);
+	for(uint64 i = 0; i < samples; i++)
+	{
+		uint64 t1 = ticks();
+		runOp(_id, *_ctx, _size);
+		_ctx->latencies.push_back(ticks() - t1);
+	}
+}
+
+//==========================================================================//
+
+/*! Измерение операции \e _id для сообщения размера \e _size в \e _threads потоках.
+	\param _id - операция.
+	\param _ctxs - состояния потоков (не менее \e _threads).
+	\param _size - размер сообщения.
+	\param _threads - количество потоков.
+	\param _duration - длительность измерения.
+	\param _counters - считывать аппаратные счётчики.
+	\returns Результат измерения.
+*/
+static Result measure(BenchId _id, std::vector<ThreadCtx*> &_ctxs, uint32 _size, uint32 _threads, double _duration, bool _counters)
+{
+	std::atomic<bool> start(false);
+	std::vector<std::thread> threads;
+	for(uint32 i = 0; i < _threads; i++)
+	{
+		if(_ctxs[i]->buf.size() < _size)
+			_ctxs[i]->buf.assign(_size, 0x5a);
+		threads.push_back(std::thread(worker, _id, _ctxs[i], _size, _duration, &start, _counters));
+	}
+	start.store(true, std::memory_order_release);
+	for(uint32 i = 0; i < _threads; i++)
+		threads[i].join();
+
+	Result res;
+	res.seconds = 0;
+	res.ops = 0;
+	res.ticks = 0;
+	for(uint32 c = 0; c < CounterCount; c++)
+		res.counts[c] = 0;
+	for(uint32 i = 0; i < _threads; i++)
+	{
+		res.ops += _ctxs[i]->ops;
+		res.ticks += _ctxs[i]->total_ticks;
+		res.seconds = std::max(res.seconds, _ctxs[i]->seconds);
+		for(uint32 c = 0; c < CounterCount; c++)
+			res.counts[c] = res.counts[c] < 0 || _ctxs[i]->counts[c] < 0 ? -1 : res.counts[c] + _ctxs[i]->counts[c];
+	}
+	uint32 op_size = benches[_id].fixed_size ? benches[_id].fixed_size : _size;
+	res.bytes = res.ops * op_size;
+	std::vector<uint64> l;
+	for(uint32 i = 0; i < _threads; i++)
+		l.insert(l.end(), _ctxs[i]->latencies.begin(), _ctxs[i]->latencies.end());
+	std::sort(l.begin(), l.end());
+	res.p50 = l.empty() ? 0 : l[l.size() / 2] / ticks_per_ns;
+	res.p99 = l.empty() ? 0 : l[(l.size() * 99) / 100] / ticks_per_ns;
+	return res;
+}
+
+//==========================================================================//
+
+/*! Вывод результата измерения строкой JSON. Значения аппаратных счётчиков (если они
+	считывались) выводятся на одну операцию, недоступные - как \b null. При сравнении
+	с базовыми результатами добавляются базовая скорость, изменение и признак регрессии.
+*/
+static void printResult(FILE *_out, BenchId _id, uint32 _size, uint32 _threads, const Result &_res, bool _counters,
+	const Comparison *_cmp)
+{
+	fprintf(_out, "{\"bench\":\"%s\",\"size\":%u,\"threads\":%u,\"ops\":%llu,\"bytes\":%llu,\"seconds\":%.6f,"
+		"\"mib_per_s\":%.3f,\"mib_per_s_mad\":%.3f,\"trials\":%u,\"cycles_per_byte\":%.3f,\"ns_per_op\":%.1f,"
+		"\"p50_ns\":%.1f,\"p99_ns\":%.1f",
+		benches[_id].name, _size, _threads, (unsigned long long)_res.ops, (unsigned long long)_res.bytes, _res.seconds,
+		throughput(_res), _res.mad, _res.trials, _res.bytes ? _res.ticks / _res.bytes : 0.,
+		_res.ops ? _res.seconds * 1e9 * _threads / _res.ops : 0., _res.p50, _res.p99);
+	if(_counters)
+	{
+		for(uint32 i = 0; i < CounterCount; i++)
+			if(_res.counts[i] < 0 || !_res.ops)
+				fprintf(_out, ",\"%s\":null", counters[i].name);
+			else
+				fprintf(_out, ",\"%s\":%.3f", counters[i].name, _res.counts[i] / _res.ops);
+		double cycles = _res.counts[CounterCycles], instructions = _res.counts[CounterInstructions];
+		if(cycles > 0 && instructions >= 0)
+			fprintf(_out, ",\"ipc\":%.3f", instructions / cycles);
+		else
+			fprintf(_out, ",\"ipc\":null");
+	}
+	if(_cmp && _cmp->base)
+		fprintf(_out, ",\"baseline_mib_per_s\":%.3f,\"change_pct\":%.2f,\"regression\":%s", _cmp->base->mib_per_s,
+			_cmp->change * 100, _cmp->regression ? "true" : "false");
+	else if(_cmp)
+		fprintf(_out, ",\"baseline_mib_per_s\":null,\"change_pct\":null,\"regression\":false");
+	fprintf(_out, "}\n");
+	fflush(_out);
+}
+
+//==========================================================================//
+
+static void usage()
+{
+	fprintf(stderr,
+		"Usage: crypton-bench [-m max_size] [-t threads] [-d seconds] [-f filter] [-o file] [-c] [-r trials]\n"
+		"                     [-b baseline] [-x threshold]\n"
+		"  -m max_size  largest message size, sizes go 8, 64, 512, ... (default: 1M, up to 1G)\n"
+		"  -t threads   largest thread count, counts go 1, 2, 4, ... (default: number of CPUs)\n"
+		"  -d seconds   minimal duration of one measurement (default: 0.2)\n"
+		"  -f filter    run only benchmarks whose name contains filter\n"
+		"  -o file      JSON results file, one object per line (default: stdout)\n"
+		"  -c           report hardware counters per operation (perf_event_open)\n"
+		"  -r trials    repeat each measurement, report the median and MAD (default: 1, with -o or -b: 5)\n"
+		"  -b baseline  compare with results saved by -o with at least 3 trials, exit with 1 on regressions\n"
+		"  -x threshold regression threshold, percent of throughput (default: 5)\n"
+		"Sizes accept K, M and G suffixes.\n");
+}
+
+//==========================================================================//
+
+int main(int argc, char **argv)
+{
+	Options opt;
+	opt.max_size = 1 << 20;
+	opt.threads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+	opt.duration = 0.2;
+	opt.filter = NULL;
+	opt.output = NULL;
+	opt.counters = false;
+	opt.trials = 0;
+	opt.baseline = NULL;
+	opt.threshold = 0.05;
+
+	int c;
+	uint64 n;
+	while((c = getopt(argc, argv, "m:t:d:f:o:cr:b:x:h")) != -1)
+	{
+		switch(c)
+		{
+		case 'm':
+			if(!parseSize(optarg, opt.max_size) || opt.max_size < 8 || opt.max_size > (1U << 30))
+				return usage(), 2;
+			break;
+		case 't':
+			if(!parseSize(optarg, n) || !n || n > 1024)
+				return usage(), 2;
+			opt.threads = n;
+			break;
+		case 'd':
+			opt.duration = atof(optarg);
+			if(opt.duration <= 0)
+				return usage(), 2;
+			break;
+		case 'f':
+			opt.filter = optarg;
+			break;
+		case 'o':
+			opt.output = optarg;
+			break;
+		case 'c':
+			opt.counters = true;
+			break;
+		case 'r':
+			if(!parseSize(optarg, n) || !n || n > 1000)
+				return usage(), 2;
+			opt.trials = n;
+			break;
+		case 'b':
+			opt.baseline = optarg;
+			break;
+		case 'x':
+			opt.threshold = atof(optarg) / 100;
+			if(opt.threshold <= 0 || opt.threshold >= 1)
+				return usage(), 2;
+			break;
+		default:
+			return usage(), 2;
+		}
+	}
+	if(optind != argc)
+		return usage(), 2;
+	if(!opt.trials)
+		opt.trials = opt.baseline || opt.output ? defaultTrials : 1;
+
+	std::vector<Baseline> baseline;
+	if(opt.baseline && !loadBaseline(opt.baseline, baseline))
+		return 1;
+
+	FILE *out = stdout;
+	if(opt.output && !(out = fopen(opt.output, "w")))
+	{
+		fprintf(stderr, "%s open error: %s\n", opt.output, strerror(errno));
+		return 1;
+	}
+	calibrateTicks();
+	if(opt.counters)
+	{
+		// Недоступные счётчики не мешают измерению: в результате они выводятся как null.
+		int fds[CounterCount];
+		double counts[CounterCount];
+		uint32 opened = openCounters(fds);
+		int err = errno;
+		stopCounters(fds, counts);
+		if(opened < CounterCount)
+			fprintf(stderr, "crypton-bench: %u of %u hardware counters available%s%s\n", opened, (uint32)CounterCount,
+				opened ? "" : ": ", opened ? "" : strerror(err));
+	}
+
+	// Объекты потоков создаются заранее, генераторы - в рабочем и в детерминированном режимах.
+	Cryptographer cr;
+	cr.init();
+	std::vector<ThreadCtx*> ctxs;
+	for(uint32 i = 0; i < opt.threads; i++)
+	{
+		ThreadCtx *ctx = new ThreadCtx;
+		ctx->cr = cr;
+		ctx->rg = new RandomGen();
+		ctx->rg->init();
+		ctx->seeded_rg = new RandomGen();
+		ctx->seeded_rg->initDeterministic(i + 1);
+		ctx->pg = new PasswordGen();
+		ctx->S = 0x0123456789abcdefULL + i;
+		ctx->sink = 0;
+		ctx->ops = 0;
+		ctx->total_ticks = 0;
+		ctx->seconds = 0;
+		ctxs.push_back(ctx);
+	}
+
+	std::vector<std::string> regressions;
+	std::vector<uint32> thread_counts;
+	for(uint32 t = 1; t < opt.threads; t <<= 1)
+		thread_counts.push_back(t);
+	thread_counts.push_back(opt.threads);
+
+	for(uint32 b = 0; b < BenchCount; b++)
+	{
+		BenchId id = (BenchId)b;
+		const BenchInfo &info = benches[b];
+		if(opt.filter && !strstr(info.name, opt.filter))
+			continue;
+		for(uint64 size = info.fixed_size ? info.fixed_size : 8; size <= opt.max_size; size <<= 3)
+		{
+			if(info.max_size && size > info.max_size)
+				break;
+			for(uint32 t = 0; t < thread_counts.size(); t++)
+			{
+				if(size * thread_counts[t] > maxTotalMemory)
+					break;
+				std::vector<Result> trials;
+				for(uint32 r = 0; r < opt.trials; r++)
+					trials.push_back(measure(id, ctxs, size, thread_counts[t], opt.duration, opt.counters));
+				Result res = summarize(trials);
+				Comparison cmp = compare(baseline, id, size, thread_counts[t], res, opt.threshold);
+				printResult(out, id, size, thread_counts[t], res, opt.counters, opt.baseline ? &cmp : NULL);
+				if(cmp.regression)
+				{
+					char line[256];
+					snprintf(line, sizeof(line), "%s size %llu: %u threads %.3f -> %.3f MiB/s (%+.1f%%)", info.name,
+						(unsigned long long)size, thread_counts[t], cmp.base->mib_per_s, throughput(res), cmp.change * 100);
+					regressions.push_back(line);
+				}
+			}
+			if(info.fixed_size)
+				break;
+		}
+	}
+
+	for(uint32 i = 0; i < ctxs.size(); i++)
+	{
+		sink += ctxs[i]->sink;
+		delete ctxs[i]->pg;
+		delete ctxs[i]->rg;
+		delete ctxs[i]->seeded_rg;
+		delete ctxs[i];
+	}
+	if(opt.output && fclose(out))
+	{
+		fprintf(stderr, "%s close error: %s\n", opt.output, strerror(errno));
+		return 1;
+	}
+	if(!regressions.empty())
+	{
+		fprintf(stderr, "crypton-bench: %u regressions (threshold %.1f%%):\n", (uint32)regressions.size(), opt.threshold * 100);
+		for(uint32 i = 0; i < regressions.size(); i++)
+			fprintf(stderr, "  %s\n", regressions[i].c_str());
+		return 1;
+	}
+	return 0;
+}
+
+//==========================================================================//
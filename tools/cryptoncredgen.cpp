@@ -0,0 +1,344 @@
+
+/*! \file cryptoncredgen.cpp
+	Утилита \e crypton-credgen генерирует заданное количество паролей (\e PasswordGen с политикой
+	\e PasswordPolicy) или токенов (\e TokenGen) и записывает их по одному в строке в стандартный
+	вывод или в файл. Каждый поток генерирует пачки учётных данных в собственный буфер, буферы
+	записываются в файл целиком крупными последовательными записями. Порядок пачек в файле
+	не определён. Во время работы в стандартный поток ошибок выводится текущая скорость генерации.
+	\par Использование:
+	\code
+	crypton-credgen -n count [-l length] [-a alphabet] [-x chars] [-L] [-c chars:min]...
+	                [-f hex|base32|base64url] [-B bytes] [-o file] [-t threads] [-b batch]
+	                [-s seq_size] [-w windows] [-q]
+	\endcode
+	Количество и размеры можно указывать с суффиксами \b K, \b M и \b G.
+	\par Пример:
+	\code
+	# 100 миллионов паролей длиной 16 символов, не менее двух цифр, без похожих символов.
+	crypton-credgen -n 100M -l 16 -L -c 0123456789:2 -o passwords.txt
+	# 10 миллионов 128-битных токенов base64url.
+	crypton-credgen -n 10M -f base64url -B 16 -o tokens.txt
+	\endcode
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "passwordgen.h"
+#include "tokenencoder.h"
+#include "toolutil.h"
+
+//==========================================================================//
+
+//! Параметры работы утилиты.
+struct Options
+{
+	uint64 count;			//!< Количество учётных данных.
+	uint32 length;			//!< Длина пароля.
+	bool tokens;			//!< Генерировать токены вместо паролей.
+	TokenEncoder::Format format;	//!< Формат токенов.
+	uint32 token_bytes;		//!< Количество случайных байтов в токене.
+	const char *output;		//!< Имя выходного файла (\b NULL - стандартный вывод).
+	uint32 threads;			//!< Количество потоков генерации.
+	uint32 batch;			//!< Количество учётных данных в пачке одного потока.
+	uint32 seq_size;		//!< Размер последовательности \e RandomGen в байтах.
+	uint32 windows;			//!< Количество тестируемых окон \e RandomGen.
+	bool quiet;				//!< Не выводить скорость генерации.
+};
+
+static std::atomic<uint64> claimed(0);		//!< Количество учётных данных, распределённых между потоками.
+static std::atomic<uint64> written(0);		//!< Количество записанных учётных данных.
+static std::atomic<bool> stopped(false);	//!< Флаг остановки (ошибка записи или закрытый канал).
+static std::atomic<bool> failed(false);		//!< Флаг ошибки записи.
+static std::mutex write_mutex;				//!< Блокировка записи в выходной файл.
+
+//==========================================================================//
+
+/*! Запись буфера в файл целиком.
+	\param _fd - дескриптор выходного файла.
+	\param _data - записываемые данные.
+	\param _size - размер \e _data в байтах.
+	\returns \b true в случае успеха, \b false - иначе.
+*/
+static bool writeAll(int _fd, const char *_data, uint64 _size)
+{
+	while(_size)
+	{
+		ssize_t n = write(_fd, _data, _size);
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno != EPIPE)
+			{
+				fprintf(stderr, "write error: %s\n", strerror(errno));
+				failed = true;
+			}
+			return false;
+		}
+		_data += n;
+		_size -= n;
+	}
+	return true;
+}
+
+//==========================================================================//
+
+/*! Функция потока генерации. Поток захватывает очередную пачку учётных данных, генерирует
+	её в свой буфер (по одной записи в строке) и записывает буфер в файл. Используется
+	либо генератор паролей \e _pg, либо генератор токенов \e _tg.
+	\param _pg - генератор паролей потока (\b NULL в режиме токенов).
+	\param _tg - генератор токенов потока (\b NULL в режиме паролей).
+	\param _fd - дескриптор выходного файла.
+	\param _opt - параметры работы.
+*/
+static void worker(PasswordGen *_pg, TokenGen *_tg, int _fd, const Options *_opt)
+{
+	const uint32 len = _tg ? _tg->tokenLength() : _opt->length;
+	const uint32 stride = len + 1;
+	std::vector<char> buf((uint64)_opt->batch * stride);
+	while(!stopped.load(std::memory_order_relaxed))
+	{
+		uint64 offset = claimed.fetch_add(_opt->batch);
+		if(offset >= _opt->count)
+			break;
+		uint32 n = _opt->count - offset < _opt->batch ? _opt->count - offset : _opt->batch;
+		if(_tg)
+			_tg->nextTokens(&buf[0], n, stride);
+		else
+			_pg->nextPasswords(&buf[0], n, len, stride);
+		for(uint32 i = 0; i < n; i++)
+			buf[(uint64)i * stride + len] = '\n';
+		std::lock_guard<std::mutex> lock(write_mutex);
+		if(!writeAll(_fd, &buf[0], (uint64)n * stride))
+		{
+			stopped = true;
+			break;
+		}
+		written.fetch_add(n, std::memory_order_relaxed);
+	}
+	memset(&buf[0], 0, buf.size());
+}
+
+//==========================================================================//
+
+/*! Текущее время в секундах.
+*/
+static double now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//==========================================================================//
+
+static void usage()
+{
+	fprintf(stderr,
+		"Usage: crypton-credgen -n count [-l length] [-a alphabet] [-x chars] [-L] [-c chars:min]...\n"
+		"                       [-f hex|base32|base64url] [-B bytes] [-o file] [-t threads] [-b batch]\n"
+		"                       [-s seq_size] [-w windows] [-q]\n"
+		"  -n count     number of credentials\n"
+		"  -l length    password length (default: 16)\n"
+		"  -a alphabet  password alphabet (default: 0-9a-zA-Z)\n"
+		"  -x chars     exclude characters from the alphabet\n"
+		"  -L           exclude look-alike characters (0O1lI|)\n"
+		"  -c chars:min require at least min characters from chars (repeatable)\n"
+		"  -f format    generate tokens instead of passwords: hex, base32 or base64url\n"
+		"  -B bytes     random bytes per token (default: 16)\n"
+		"  -o file      output file (default: stdout)\n"
+		"  -t threads   generator threads (default: number of CPUs)\n"
+		"  -b batch     credentials per thread write (default: 64K)\n"
+		"  -s seq_size  RandomGen sequence size in bytes (default: 1M)\n"
+		"  -w windows   FIPS windows tested per refill, 0 - all (default: 16)\n"
+		"  -q           do not report throughput\n"
+		"Counts and sizes accept K, M and G suffixes.\n");
+}
+
+//==========================================================================//
+
+int main(int argc, char **argv)
+{
+	Options opt;
+	opt.count = 0;
+	opt.length = 16;
+	opt.tokens = false;
+	opt.format = TokenEncoder::Base64Url;
+	opt.token_bytes = 16;
+	opt.output = NULL;
+	opt.threads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+	opt.batch = 65536;
+	opt.seq_size = 1 << 20;
+	opt.windows = 16;
+	opt.quiet = false;
+	PasswordPolicy policy;
+
+	int c;
+	uint64 n;
+	while((c = getopt(argc, argv, "n:l:a:x:Lc:f:B:o:t:b:s:w:qh")) != -1)
+	{
+		switch(c)
+		{
+		case 'n':
+			if(!parseSize(optarg, opt.count) || !opt.count)
+				return usage(), 2;
+			break;
+		case 'l':
+			if(!parseSize(optarg, n) || !n || n > 4096)
+				return usage(), 2;
+			opt.length = n;
+			break;
+		case 'a':
+			policy.setAlphabeth(optarg);
+			break;
+		case 'x':
+			policy.exclude(optarg);
+			break;
+		case 'L':
+			policy.excludeLookAlikes();
+			break;
+		case 'c':
+		{
+			const char *sep = strrchr(optarg, ':');
+			if(!sep || sep == optarg || !parseSize(sep + 1, n) || n > 4096)
+				return usage(), 2;
+			policy.addClass(std::string(optarg, sep - optarg).c_str(), n);
+			break;
+		}
+		case 'f':
+			opt.tokens = true;
+			if(!strcmp(optarg, "hex"))
+				opt.format = TokenEncoder::Hex;
+			else if(!strcmp(optarg, "base32"))
+				opt.format = TokenEncoder::Base32;
+			else if(!strcmp(optarg, "base64url"))
+				opt.format = TokenEncoder::Base64Url;
+			else
+				return usage(), 2;
+			break;
+		case 'B':
+			if(!parseSize(optarg, n) || !n || n > 4096)
+				return usage(), 2;
+			opt.token_bytes = n;
+			break;
+		case 'o':
+			opt.output = optarg;
+			break;
+		case 't':
+			if(!parseSize(optarg, n) || !n || n > 1024)
+				return usage(), 2;
+			opt.threads = n;
+			break;
+		case 'b':
+			if(!parseSize(optarg, n) || !n || n > (1U << 24))
+				return usage(), 2;
+			opt.batch = n;
+			break;
+		case 's':
+			if(!parseSize(optarg, n) || !n || n > (1U << 30))
+				return usage(), 2;
+			opt.seq_size = n;
+			break;
+		case 'w':
+			if(!parseSize(optarg, n) || n > 0xffffffffULL)
+				return usage(), 2;
+			opt.windows = n;
+			break;
+		case 'q':
+			opt.quiet = true;
+			break;
+		default:
+			return usage(), 2;
+		}
+	}
+	if(optind != argc || !opt.count)
+		return usage(), 2;
+
+	// Генераторы создаются последовательно: самотестирование RandomGen использует random().
+	std::vector<PasswordGen> pgens;
+	std::vector<TokenGen> tgens;
+	if(opt.tokens)
+	{
+		tgens.reserve(opt.threads);
+		for(uint32 i = 0; i < opt.threads; i++)
+			tgens.push_back(TokenGen(opt.format, opt.token_bytes, opt.seq_size, opt.windows));
+	}
+	else
+	{
+		pgens.reserve(opt.threads);
+		for(uint32 i = 0; i < opt.threads; i++)
+		{
+			pgens.push_back(PasswordGen(NULL, opt.seq_size, opt.windows));
+			if(!pgens.back().setPolicy(policy))
+			{
+				fprintf(stderr, "invalid policy: alphabet too small or class without alphabet characters\n");
+				return 2;
+			}
+		}
+		if(opt.length < policy.required())
+		{
+			fprintf(stderr, "password length %u is less than %u required characters\n", opt.length, policy.required());
+			return 2;
+		}
+	}
+
+	int fd = STDOUT_FILENO;
+	if(opt.output)
+	{
+		fd = open(opt.output, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		if(fd < 0)
+		{
+			fprintf(stderr, "%s open error: %s\n", opt.output, strerror(errno));
+			return 1;
+		}
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	double start = now();
+	std::vector<std::thread> threads;
+	for(uint32 i = 0; i < opt.threads; i++)
+		threads.push_back(std::thread(worker, opt.tokens ? NULL : &pgens[i], opt.tokens ? &tgens[i] : NULL, fd, &opt));
+
+	// Вывод скорости генерации раз в секунду.
+	uint64 last = 0;
+	double last_time = start;
+	while(!opt.quiet && !stopped && written < opt.count)
+	{
+		usleep(100000);
+		double t = now();
+		if(t - last_time < 1.)
+			continue;
+		uint64 w = written;
+		fprintf(stderr, "\r%llu written, %.0f/s    ", (unsigned long long)w, (w - last) / (t - last_time));
+		last = w;
+		last_time = t;
+	}
+	for(uint32 i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	double elapsed = now() - start;
+	if(!opt.quiet)
+		fprintf(stderr, "\r%llu credentials in %.2f s, %.0f/s    \n", (unsigned long long)written.load(),
+			elapsed, written / (elapsed > 0 ? elapsed : 1));
+	if(opt.output && close(fd) < 0)
+	{
+		fprintf(stderr, "%s close error: %s\n", opt.output, strerror(errno));
+		return 1;
+	}
+	return failed ? 1 : 0;
+}
+
+//==========================================================================//
@@ -0,0 +1,258 @@
+
+/*! \file cryptonrand.cpp
+	Утилита \e crypton-rand записывает поток случайных байтов, вырабатываемых \e RandomGen,
+	в стандартный вывод или в файл. Поток вырабатывается несколькими потоками (каждый со своим
+	экземпляром \e RandomGen) крупными фрагментами и может быть бесконечным или ограниченным по длине.
+	Во время работы в стандартный поток ошибок выводится текущая скорость выработки.
+	\note Каждый выходной байт \e RandomGen - это байт, прочитанный из <b>/dev/urandom</b>
+	и зашифрованный программной реализацией ГОСТ 28147-89 (гаммирование с обратной связью).
+	Поэтому скорость одного потока ограничена скоростью шифрования (порядка 20 МиБ/с на ядро)
+	и на порядок ниже скорости чтения самого <b>/dev/urandom</b>; утилита не является его
+	более быстрой заменой, скорость растёт только с количеством потоков (\e -t).
+	\par Использование:
+	\code
+	crypton-rand [-n size] [-o file] [-t threads] [-b buffer] [-s seq_size] [-w windows] [-q]
+	\endcode
+	Размеры можно указывать с суффиксами \b K, \b M и \b G.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "randomgen.h"
+#include "toolutil.h"
+
+//==========================================================================//
+
+//! Параметры работы утилиты.
+struct Options
+{
+	uint64 total;			//!< Количество выводимых байтов (0 - бесконечный поток).
+	const char *output;		//!< Имя выходного файла (\b NULL - стандартный вывод).
+	uint32 threads;			//!< Количество потоков выработки.
+	uint32 buffer;			//!< Размер буфера записи одного потока в байтах.
+	uint32 seq_size;		//!< Размер последовательности \e RandomGen в байтах.
+	uint32 windows;			//!< Количество тестируемых окон \e RandomGen.
+	bool quiet;				//!< Не выводить скорость выработки.
+};
+
+static std::atomic<uint64> claimed(0);		//!< Количество байтов, распределённых между потоками.
+static std::atomic<uint64> written(0);		//!< Количество записанных байтов.
+static std::atomic<bool> stopped(false);	//!< Флаг остановки (ошибка записи или закрытый канал).
+static std::atomic<bool> failed(false);		//!< Флаг ошибки записи.
+static std::mutex write_mutex;				//!< Блокировка записи в выходной файл.
+
+//==========================================================================//
+
+/*! Запись буфера в файл целиком.
+	\param _fd - дескриптор выходного файла.
+	\param _data - записываемые данные.
+	\param _size - размер \e _data в байтах.
+	\returns \b true в случае успеха, \b false - иначе.
+*/
+static bool writeAll(int _fd, const uint8 *_data, uint64 _size)
+{
+	while(_size)
+	{
+		ssize_t n = write(_fd, _data, _size);
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno != EPIPE)
+			{
+				fprintf(stderr, "write error: %s\n", strerror(errno));
+				failed = true;
+			}
+			return false;
+		}
+		_data += n;
+		_size -= n;
+	}
+	return true;
+}
+
+//==========================================================================//
+
+/*! Функция потока выработки. Поток захватывает очередной фрагмент выходного потока,
+	заполняет свой буфер с помощью <em>RandomGen::nextBytes()</em> и записывает его в файл.
+	\param _rg - генератор потока.
+	\param _fd - дескриптор выходного файла.
+	\param _opt - параметры работы.
+*/
+static void worker(RandomGen *_rg, int _fd, const Options *_opt)
+{
+	std::vector<uint8> buf(_opt->buffer);
+	while(!stopped.load(std::memory_order_relaxed))
+	{
+		uint64 size = _opt->buffer;
+		if(_opt->total)
+		{
+			uint64 offset = claimed.fetch_add(size);
+			if(offset >= _opt->total)
+				break;
+			if(_opt->total - offset < size)
+				size = _opt->total - offset;
+		}
+		_rg->nextBytes(&buf[0], size);
+		std::lock_guard<std::mutex> lock(write_mutex);
+		if(!writeAll(_fd, &buf[0], size))
+		{
+			stopped = true;
+			break;
+		}
+		written.fetch_add(size, std::memory_order_relaxed);
+	}
+}
+
+//==========================================================================//
+
+/*! Текущее время в секундах.
+*/
+static double now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//==========================================================================//
+
+static void usage()
+{
+	fprintf(stderr,
+		"Usage: crypton-rand [-n size] [-o file] [-t threads] [-b buffer] [-s seq_size] [-w windows] [-q]\n"
+		"  -n size      number of bytes to write (default: endless stream)\n"
+		"  -o file      output file (default: stdout)\n"
+		"  -t threads   generator threads (default: number of CPUs)\n"
+		"  -b buffer    write buffer per thread (default: 4M)\n"
+		"  -s seq_size  RandomGen sequence size (default: 1M)\n"
+		"  -w windows   FIPS windows tested per refill, 0 - all (default: 16)\n"
+		"  -q           do not report throughput\n"
+		"Sizes accept K, M and G suffixes.\n");
+}
+
+//==========================================================================//
+
+int main(int argc, char **argv)
+{
+	Options opt;
+	opt.total = 0;
+	opt.output = NULL;
+	opt.threads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+	opt.buffer = 4 << 20;
+	opt.seq_size = 1 << 20;
+	opt.windows = 16;
+	opt.quiet = false;
+
+	int c;
+	uint64 n;
+	while((c = getopt(argc, argv, "n:o:t:b:s:w:qh")) != -1)
+	{
+		switch(c)
+		{
+		case 'n':
+			if(!parseSize(optarg, opt.total) || !opt.total)
+				return usage(), 2;
+			break;
+		case 'o':
+			opt.output = optarg;
+			break;
+		case 't':
+			if(!parseSize(optarg, n) || !n || n > 1024)
+				return usage(), 2;
+			opt.threads = n;
+			break;
+		case 'b':
+			if(!parseSize(optarg, n) || !n || n > (1U << 30))
+				return usage(), 2;
+			opt.buffer = n;
+			break;
+		case 's':
+			if(!parseSize(optarg, n) || !n || n > (1U << 30))
+				return usage(), 2;
+			opt.seq_size = n;
+			break;
+		case 'w':
+			if(!parseSize(optarg, n) || n > 0xffffffffULL)
+				return usage(), 2;
+			opt.windows = n;
+			break;
+		case 'q':
+			opt.quiet = true;
+			break;
+		default:
+			return usage(), 2;
+		}
+	}
+	if(optind != argc)
+		return usage(), 2;
+
+	int fd = STDOUT_FILENO;
+	if(opt.output)
+	{
+		fd = open(opt.output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0)
+		{
+			fprintf(stderr, "%s open error: %s\n", opt.output, strerror(errno));
+			return 1;
+		}
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	// Генераторы инициализируются последовательно: самотестирование использует random().
+	std::vector<RandomGen> gens;
+	gens.reserve(opt.threads);
+	for(uint32 i = 0; i < opt.threads; i++)
+	{
+		gens.push_back(RandomGen(opt.seq_size, opt.windows));
+		gens.back().init();
+	}
+
+	double start = now();
+	std::vector<std::thread> threads;
+	for(uint32 i = 0; i < opt.threads; i++)
+		threads.push_back(std::thread(worker, &gens[i], fd, &opt));
+
+	// Вывод скорости выработки раз в секунду.
+	uint64 last = 0;
+	double last_time = start;
+	while(!opt.quiet && !stopped && (!opt.total || written < opt.total))
+	{
+		usleep(100000);
+		double t = now();
+		if(t - last_time < 1.)
+			continue;
+		uint64 w = written;
+		fprintf(stderr, "\r%llu MiB written, %.1f MiB/s    ", (unsigned long long)(w >> 20),
+			(w - last) / (t - last_time) / (1 << 20));
+		last = w;
+		last_time = t;
+	}
+	for(uint32 i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	double elapsed = now() - start;
+	if(!opt.quiet)
+		fprintf(stderr, "\r%llu bytes in %.2f s, %.1f MiB/s    \n", (unsigned long long)written.load(),
+			elapsed, written / (elapsed > 0 ? elapsed : 1) / (1 << 20));
+	if(opt.output && close(fd) < 0)
+	{
+		fprintf(stderr, "%s close error: %s\n", opt.output, strerror(errno));
+		return 1;
+	}
+	return failed ? 1 : 0;
+}
+
+//==========================================================================//
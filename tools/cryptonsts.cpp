@@ -0,0 +1,635 @@
+
+/*! \file cryptonsts.cpp
+	Утилита \e crypton-sts вырабатывает заданный объём данных с помощью \e RandomGen и проверяет
+	их набором статистических тестов NIST SP 800-22: частотным, частотным в блоках, тестом серий,
+	тестом самой длинной серии единиц в блоке, спектральным (ДПФ), тестом перекрывающихся шаблонов
+	(serial), тестом приближённой энтропии и тестом кумулятивных сумм.
+	Данные разбиваются на последовательности длиной \e -l бит, которые обрабатываются параллельно
+	несколькими потоками, каждый со своим экземпляром \e RandomGen. В детерминированном режиме
+	(\e -d) датчик заново инициализируется для каждой последовательности значением \e seed плюс
+	номер последовательности, поэтому результаты не зависят от количества потоков и порядка
+	захвата последовательностей. Подсчёт единиц производится
+	по 64-битным словам (<em>__builtin_popcountll()</em>).
+	Для каждого теста выводятся доля прошедших последовательностей и P-значение равномерности
+	распределения P-значений. Если какой-либо тест не проходит, утилита завершается с кодом \b 1.
+	\par Использование:
+	\code
+	crypton-sts [-n size] [-l bits] [-t threads] [-a alpha] [-s seq_size] [-w windows] [-d seed]
+	\endcode
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <cmath>
+
+#include <atomic>
+#include <complex>
+#include <thread>
+#include <vector>
+
+#include "randomgen.h"
+#include "toolutil.h"
+
+using namespace std;
+
+//==========================================================================//
+
+//! Номера P-значений, вычисляемых для каждой последовательности.
+enum TestId
+{
+	Frequency,			//!< Частотный тест.
+	BlockFrequency,		//!< Частотный тест в блоках.
+	Runs,				//!< Тест серий.
+	LongestRun,			//!< Тест самой длинной серии единиц в блоке.
+	Fft,				//!< Спектральный тест.
+	Serial1,			//!< Тест перекрывающихся шаблонов, первое P-значение.
+	Serial2,			//!< Тест перекрывающихся шаблонов, второе P-значение.
+	ApproxEntropy,		//!< Тест приближённой энтропии.
+	CusumForward,		//!< Тест кумулятивных сумм (прямой).
+	CusumBackward,		//!< Тест кумулятивных сумм (обратный).
+	TestCount			//!< Количество P-значений.
+};
+
+static const char *test_names[TestCount] = {"Frequency", "BlockFrequency", "Runs", "LongestRun", "FFT",
+	"Serial", "Serial", "ApproximateEntropy", "CumulativeSums", "CumulativeSums"};
+
+const uint32 blockFrequencyM = 128;		//!< Длина блока частотного теста в блоках (бит).
+const uint32 longestRunM = 10000;		//!< Длина блока теста самой длинной серии.
+const uint32 serialM = 16;				//!< Длина шаблона теста перекрывающихся шаблонов.
+const uint32 approxEntropyM = 10;		//!< Длина шаблона теста приближённой энтропии.
+
+//==========================================================================//
+
+//! Параметры работы утилиты.
+struct Options
+{
+	uint64 total;			//!< Объём проверяемых данных в байтах.
+	uint32 seq_bits;		//!< Длина одной последовательности в битах.
+	uint32 threads;			//!< Количество потоков.
+	double alpha;			//!< Уровень значимости.
+	uint32 seq_size;		//!< Размер последовательности \e RandomGen в байтах.
+	uint32 windows;			//!< Количество тестируемых окон \e RandomGen.
+	bool seeded;			//!< Использовать детерминированный режим \e RandomGen.
+	uint64 seed;			//!< Начальное значение детерминированного режима.
+};
+
+//==========================================================================//
+
+static const double machEp = 1.11022302462515654042e-16;
+static const double maxLog = 7.09782712893383996843e2;
+static const double big = 4.503599627370496e15;
+static const double bigInv = 2.22044604925031308085e-16;
+
+static double igamc(double a, double x);
+
+/*! Нижняя регуляризованная неполная гамма-функция (разложение в ряд).
+*/
+static double igam(double a, double x)
+{
+	if(x <= 0 || a <= 0)
+		return 0.;
+	if(x > 1. && x > a)
+		return 1. - igamc(a, x);
+	double ax = a * log(x) - x - lgamma(a);
+	if(ax < -maxLog)
+		return 0.;
+	ax = exp(ax);
+	double r = a, c = 1., ans = 1.;
+	do
+	{
+		r += 1.;
+		c *= x / r;
+		ans += c;
+	}
+	while(c / ans > machEp);
+	return ans * ax / a;
+}
+
+/*! Верхняя регуляризованная неполная гамма-функция (цепная дробь).
+*/
+static double igamc(double a, double x)
+{
+	if(x <= 0 || a <= 0)
+		return 1.;
+	if(x < 1. || x < a)
+		return 1. - igam(a, x);
+	double ax = a * log(x) - x - lgamma(a);
+	if(ax < -maxLog)
+		return 0.;
+	ax = exp(ax);
+	double y = 1. - a, z = x + y + 1., c = 0.;
+	double pkm2 = 1., qkm2 = x, pkm1 = x + 1., qkm1 = z * x;
+	double ans = pkm1 / qkm1, t;
+	do
+	{
+		c += 1.;
+		y += 1.;
+		z += 2.;
+		double yc = y * c;
+		double pk = pkm1 * z - pkm2 * yc;
+		double qk = qkm1 * z - qkm2 * yc;
+		if(qk != 0)
+		{
+			double r = pk / qk;
+			t = fabs((ans - r) / r);
+			ans = r;
+		}
+		else
+			t = 1.;
+		pkm2 = pkm1;
+		pkm1 = pk;
+		qkm2 = qkm1;
+		qkm1 = qk;
+		if(fabs(pk) > big)
+		{
+			pkm2 *= bigInv;
+			pkm1 *= bigInv;
+			qkm2 *= bigInv;
+			qkm1 *= bigInv;
+		}
+	}
+	while(t > machEp);
+	return ans * ax;
+}
+
+/*! Функция стандартного нормального распределения.
+*/
+static double normal(double x)
+{
+	return 0.5 * erfc(-x / sqrt(2.));
+}
+
+//==========================================================================//
+
+//! Битовая последовательность, хранимая 64-битными словами (старший бит слова - первый).
+struct BitSeq
+{
+	vector<uint64> words;	//!< Слова последовательности.
+	uint32 n;				//!< Длина последовательности в битах.
+
+	uint32 bit(uint32 i) const { return (words[i >> 6] >> (63 - (i & 63))) & 1; }
+
+	/*! Количество единиц в диапазоне [\e from, \e from + \e len).
+	*/
+	uint32 ones(uint32 from, uint32 len) const
+	{
+		uint32 res = 0;
+		uint32 end = from + len;
+		while(from < end && (from & 63))
+			res += bit(from++);
+		for(; from + 64 <= end; from += 64)
+			res += __builtin_popcountll(words[from >> 6]);
+		while(from < end)
+			res += bit(from++);
+		return res;
+	}
+
+	/*! Значение \e m-битного шаблона, начинающегося с позиции \e i (с переходом через конец).
+	*/
+	uint32 pattern(uint32 i, uint32 m) const
+	{
+		uint32 res = 0;
+		for(uint32 k = 0; k < m; k++)
+			res = (res << 1) | bit((i + k) % n);
+		return res;
+	}
+};
+
+//==========================================================================//
+
+//! Таблица кумулятивных сумм для байта (старший бит - первый).
+struct CusumByte
+{
+	int8 sum;		//!< Сумма \f$ \pm 1 \f$ по байту.
+	int8 max;		//!< Максимум частичных сумм.
+	int8 min;		//!< Минимум частичных сумм.
+};
+
+static CusumByte cusum_table[2][256];	//!< Таблицы для прямого [0] и обратного [1] прохода.
+
+static void initCusumTable()
+{
+	for(uint32 v = 0; v < 256; v++)
+		for(uint32 dir = 0; dir < 2; dir++)
+		{
+			int32 s = 0, mx = -100, mn = 100;
+			for(uint32 k = 0; k < 8; k++)
+			{
+				uint32 b = dir == 0 ? (v >> (7 - k)) & 1 : (v >> k) & 1;
+				s += b ? 1 : -1;
+				if(s > mx)
+					mx = s;
+				if(s < mn)
+					mn = s;
+			}
+			cusum_table[dir][v].sum = s;
+			cusum_table[dir][v].max = mx;
+			cusum_table[dir][v].min = mn;
+		}
+}
+
+//==========================================================================//
+
+static double testFrequency(const BitSeq &_seq)
+{
+	double s = 2. * _seq.ones(0, _seq.n) - _seq.n;
+	return erfc(fabs(s) / sqrt((double)_seq.n) / sqrt(2.));
+}
+
+static double testBlockFrequency(const BitSeq &_seq)
+{
+	uint32 N = _seq.n / blockFrequencyM;
+	double chi2 = 0;
+	for(uint32 i = 0; i < N; i++)
+	{
+		double pi = (double)_seq.ones(i * blockFrequencyM, blockFrequencyM) / blockFrequencyM - 0.5;
+		chi2 += pi * pi;
+	}
+	chi2 *= 4. * blockFrequencyM;
+	return igamc(N / 2., chi2 / 2.);
+}
+
+static double testRuns(const BitSeq &_seq)
+{
+	double pi = (double)_seq.ones(0, _seq.n) / _seq.n;
+	if(fabs(pi - 0.5) >= 2. / sqrt((double)_seq.n))
+		return 0.;
+	// Количество смен значения соседних битов по словам.
+	uint64 v = 1;
+	uint32 words = _seq.n / 64;
+	for(uint32 i = 0; i < words; i++)
+	{
+		uint64 w = _seq.words[i];
+		v += __builtin_popcountll((w ^ (w << 1)) & ~1ULL);
+		if(i + 1 < words)
+			v += (w & 1) != (_seq.words[i + 1] >> 63);
+	}
+	double p = pi * (1. - pi);
+	return erfc(fabs(v - 2. * _seq.n * p) / (2. * sqrt(2. * _seq.n) * p));
+}
+
+static double testLongestRun(const BitSeq &_seq)
+{
+	static const double pi[7] = {0.0882, 0.2092, 0.2483, 0.1933, 0.1208, 0.0675, 0.0727};
+	uint32 N = _seq.n / longestRunM;
+	uint32 nu[7] = {0};
+	for(uint32 b = 0; b < N; b++)
+	{
+		uint32 run = 0, longest = 0;
+		for(uint32 i = b * longestRunM; i < (b + 1) * longestRunM; i++)
+		{
+			if(_seq.bit(i))
+			{
+				run++;
+				if(run > longest)
+					longest = run;
+			}
+			else
+				run = 0;
+		}
+		if(longest <= 10)
+			nu[0]++;
+		else if(longest >= 16)
+			nu[6]++;
+		else
+			nu[longest - 10]++;
+	}
+	double chi2 = 0;
+	for(uint32 i = 0; i < 7; i++)
+		chi2 += (nu[i] - N * pi[i]) * (nu[i] - N * pi[i]) / (N * pi[i]);
+	return igamc(3., chi2 / 2.);
+}
+
+/*! Итеративное быстрое преобразование Фурье по основанию 2 (длина - степень двойки).
+*/
+static void fft(vector<complex<double> > &_x)
+{
+	uint32 n = _x.size();
+	for(uint32 i = 1, j = 0; i < n; i++)
+	{
+		uint32 bit = n >> 1;
+		for(; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if(i < j)
+			swap(_x[i], _x[j]);
+	}
+	for(uint32 len = 2; len <= n; len <<= 1)
+	{
+		double ang = -2. * M_PI / len;
+		complex<double> wlen(cos(ang), sin(ang));
+		for(uint32 i = 0; i < n; i += len)
+		{
+			complex<double> w(1.);
+			for(uint32 k = 0; k < len / 2; k++)
+			{
+				complex<double> u = _x[i + k], v = _x[i + k + len / 2] * w;
+				_x[i + k] = u + v;
+				_x[i + k + len / 2] = u - v;
+				w *= wlen;
+			}
+		}
+	}
+}
+
+static double testFft(const BitSeq &_seq, vector<complex<double> > &_buf)
+{
+	// Используется наибольший префикс длиной в степень двойки.
+	uint32 n = 1;
+	while(n * 2 <= _seq.n)
+		n *= 2;
+	_buf.resize(n);
+	for(uint32 i = 0; i < n; i++)
+		_buf[i] = _seq.bit(i) ? 1. : -1.;
+	fft(_buf);
+	double T = sqrt(log(1. / 0.05) * n);
+	double N0 = 0.95 * n / 2.;
+	uint32 N1 = 0;
+	for(uint32 i = 0; i < n / 2; i++)
+		if(abs(_buf[i]) < T)
+			N1++;
+	double d = (N1 - N0) / sqrt(n * 0.95 * 0.05 / 4.);
+	return erfc(fabs(d) / sqrt(2.));
+}
+
+/*! Подсчёт перекрывающихся \e m-битных шаблонов (с переходом через конец) в \e _counts.
+*/
+static void countPatterns(const BitSeq &_seq, uint32 m, vector<uint32> &_counts)
+{
+	_counts.assign(1U << m, 0);
+	if(!m)
+		return;
+	uint32 mask = (1U << m) - 1;
+	uint32 v = _seq.pattern(0, m);
+	_counts[v]++;
+	for(uint32 i = 1; i < _seq.n; i++)
+	{
+		v = ((v << 1) | _seq.bit((i + m - 1) % _seq.n)) & mask;
+		_counts[v]++;
+	}
+}
+
+static double psi2(const BitSeq &_seq, uint32 m, vector<uint32> &_counts)
+{
+	if(!m)
+		return 0.;
+	countPatterns(_seq, m, _counts);
+	double sum = 0;
+	for(uint32 i = 0; i < _counts.size(); i++)
+		sum += (double)_counts[i] * _counts[i];
+	return sum * (1U << m) / _seq.n - _seq.n;
+}
+
+static void testSerial(const BitSeq &_seq, vector<uint32> &_counts, double &_p1, double &_p2)
+{
+	double p0 = psi2(_seq, serialM, _counts);
+	double p1 = psi2(_seq, serialM - 1, _counts);
+	double p2 = psi2(_seq, serialM - 2, _counts);
+	_p1 = igamc(pow(2., serialM - 2), (p0 - p1) / 2.);
+	_p2 = igamc(pow(2., serialM - 3), (p0 - 2. * p1 + p2) / 2.);
+}
+
+static double phi(const BitSeq &_seq, uint32 m, vector<uint32> &_counts)
+{
+	countPatterns(_seq, m, _counts);
+	double sum = 0;
+	for(uint32 i = 0; i < _counts.size(); i++)
+		if(_counts[i])
+		{
+			double p = (double)_counts[i] / _seq.n;
+			sum += p * log(p);
+		}
+	return sum;
+}
+
+static double testApproxEntropy(const BitSeq &_seq, vector<uint32> &_counts)
+{
+	double apen = phi(_seq, approxEntropyM, _counts) - phi(_seq, approxEntropyM + 1, _counts);
+	double chi2 = 2. * _seq.n * (log(2.) - apen);
+	return igamc(pow(2., approxEntropyM - 1), chi2 / 2.);
+}
+
+static double testCusum(const BitSeq &_seq, bool _backward)
+{
+	// Максимум модуля частичных сумм по байтовым таблицам.
+	uint32 bytes = _seq.n / 8;
+	int32 s = 0, z = 0;
+	for(uint32 k = 0; k < bytes; k++)
+	{
+		uint32 i = _backward ? bytes - 1 - k : k;
+		uint8 v = _seq.words[i >> 3] >> (56 - (i & 7) * 8);
+		const CusumByte &c = cusum_table[_backward][v];
+		if(abs(s + c.max) > z)
+			z = abs(s + c.max);
+		if(abs(s + c.min) > z)
+			z = abs(s + c.min);
+		s += c.sum;
+	}
+	double n = _seq.n;
+	double sqn = sqrt(n);
+	double sum1 = 0, sum2 = 0;
+	for(int32 k = (int32)floor((-n / z + 1) / 4); k <= (int32)floor((n / z - 1) / 4); k++)
+		sum1 += normal((4. * k + 1) * z / sqn) - normal((4. * k - 1) * z / sqn);
+	for(int32 k = (int32)floor((-n / z - 3) / 4); k <= (int32)floor((n / z - 1) / 4); k++)
+		sum2 += normal((4. * k + 3) * z / sqn) - normal((4. * k + 1) * z / sqn);
+	return 1. - sum1 + sum2;
+}
+
+//==========================================================================//
+
+//! Общие данные потоков проверки.
+struct Shared
+{
+	const Options *opt;				//!< Параметры работы.
+	uint32 seq_count;				//!< Количество последовательностей.
+	atomic<uint32> next;			//!< Номер следующей необработанной последовательности.
+	vector<double> p_values;		//!< P-значения: \e TestCount значений на последовательность.
+};
+
+/*! Функция потока проверки. Поток захватывает очередную последовательность,
+	вырабатывает её с помощью \e RandomGen и выполняет над ней все тесты. В детерминированном
+	режиме перед выработкой датчик инициализируется значением <em>seed + idx</em>.
+*/
+static void worker(RandomGen *_rg, Shared *_sh)
+{
+	uint32 bytes = _sh->opt->seq_bits / 8;
+	vector<uint8> buf(bytes);
+	BitSeq seq;
+	seq.n = _sh->opt->seq_bits;
+	seq.words.resize(seq.n / 64);
+	vector<complex<double> > fft_buf;
+	vector<uint32> counts;
+	for(uint32 idx; (idx = _sh->next.fetch_add(1)) < _sh->seq_count;)
+	{
+		if(_sh->opt->seeded)
+			_rg->initDeterministic(_sh->opt->seed + idx);
+		_rg->nextBytes(&buf[0], bytes);
+		for(uint32 i = 0; i < seq.words.size(); i++)
+		{
+			uint64 w;
+			memcpy(&w, &buf[i * 8], sizeof(w));
+			seq.words[i] = __builtin_bswap64(w);
+		}
+		double *p = &_sh->p_values[(uint64)idx * TestCount];
+		p[Frequency] = testFrequency(seq);
+		p[BlockFrequency] = testBlockFrequency(seq);
+		p[Runs] = testRuns(seq);
+		p[LongestRun] = testLongestRun(seq);
+		p[Fft] = testFft(seq, fft_buf);
+		testSerial(seq, counts, p[Serial1], p[Serial2]);
+		p[ApproxEntropy] = testApproxEntropy(seq, counts);
+		p[CusumForward] = testCusum(seq, false);
+		p[CusumBackward] = testCusum(seq, true);
+	}
+}
+
+//==========================================================================//
+
+static double now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"Usage: crypton-sts [-n size] [-l bits] [-t threads] [-a alpha] [-s seq_size] [-w windows] [-d seed]\n"
+		"  -n size      amount of data to test (default: 128M)\n"
+		"  -l bits      sequence length in bits, multiple of 64 (default: 1048576)\n"
+		"  -t threads   worker threads (default: number of CPUs)\n"
+		"  -a alpha     significance level (default: 0.01)\n"
+		"  -s seq_size  RandomGen sequence size (default: 1M)\n"
+		"  -w windows   FIPS windows tested per refill, 0 - all (default: 16)\n"
+		"  -d seed      use RandomGen::initDeterministic(seed + sequence index)\n"
+		"Sizes accept K, M and G suffixes.\n");
+}
+
+//==========================================================================//
+
+int main(int argc, char **argv)
+{
+	Options opt;
+	opt.total = 128 << 20;
+	opt.seq_bits = 1 << 20;
+	opt.threads = thread::hardware_concurrency() ? thread::hardware_concurrency() : 1;
+	opt.alpha = 0.01;
+	opt.seq_size = 1 << 20;
+	opt.windows = 16;
+	opt.seeded = false;
+	opt.seed = 0;
+
+	int c;
+	uint64 n;
+	while((c = getopt(argc, argv, "n:l:t:a:s:w:d:h")) != -1)
+	{
+		switch(c)
+		{
+		case 'n':
+			if(!parseSize(optarg, opt.total) || !opt.total)
+				return usage(), 2;
+			break;
+		case 'l':
+			if(!parseSize(optarg, n) || n < longestRunM * 75 || n % 64 || n > (1U << 30))
+				return usage(), 2;
+			opt.seq_bits = n;
+			break;
+		case 't':
+			if(!parseSize(optarg, n) || !n || n > 1024)
+				return usage(), 2;
+			opt.threads = n;
+			break;
+		case 'a':
+			opt.alpha = atof(optarg);
+			if(opt.alpha <= 0 || opt.alpha >= 1)
+				return usage(), 2;
+			break;
+		case 's':
+			if(!parseSize(optarg, n) || !n || n > (1U << 30))
+				return usage(), 2;
+			opt.seq_size = n;
+			break;
+		case 'w':
+			if(!parseSize(optarg, n) || n > 0xffffffffULL)
+				return usage(), 2;
+			opt.windows = n;
+			break;
+		case 'd':
+			if(!parseSize(optarg, opt.seed))
+				return usage(), 2;
+			opt.seeded = true;
+			break;
+		default:
+			return usage(), 2;
+		}
+	}
+	if(optind != argc)
+		return usage(), 2;
+
+	Shared sh;
+	sh.opt = &opt;
+	sh.seq_count = opt.total * 8 / opt.seq_bits;
+	if(!sh.seq_count)
+	{
+		fprintf(stderr, "size is smaller than one sequence\n");
+		return 2;
+	}
+	sh.next = 0;
+	sh.p_values.resize((uint64)sh.seq_count * TestCount);
+	initCusumTable();
+
+	// Генераторы инициализируются последовательно: самотестирование использует random().
+	// В детерминированном режиме инициализация выполняется потоками для каждой последовательности.
+	vector<RandomGen> gens;
+	gens.reserve(opt.threads);
+	for(uint32 i = 0; i < opt.threads; i++)
+	{
+		gens.push_back(RandomGen(opt.seq_size, opt.windows));
+		if(!opt.seeded)
+			gens.back().init();
+	}
+
+	double start = now();
+	vector<thread> threads;
+	for(uint32 i = 0; i < opt.threads; i++)
+		threads.push_back(thread(worker, &gens[i], &sh));
+	for(uint32 i = 0; i < threads.size(); i++)
+		threads[i].join();
+	double elapsed = now() - start;
+
+	// Доля прошедших последовательностей и равномерность P-значений (10 интервалов).
+	uint32 m = sh.seq_count;
+	double p_hat = 1. - opt.alpha;
+	double min_prop = p_hat - 3. * sqrt(p_hat * opt.alpha / m);
+	bool ok = true;
+	printf("%u sequences of %u bits, %.2f s, %u threads\n", m, opt.seq_bits, elapsed, opt.threads);
+	printf("%-20s %10s %12s %s\n", "test", "passed", "uniformity", "result");
+	for(uint32 t = 0; t < TestCount; t++)
+	{
+		uint32 passed = 0;
+		uint32 bins[10] = {0};
+		for(uint32 i = 0; i < m; i++)
+		{
+			double p = sh.p_values[(uint64)i * TestCount + t];
+			if(p >= opt.alpha)
+				passed++;
+			uint32 b = p * 10;
+			bins[b > 9 ? 9 : b]++;
+		}
+		double chi2 = 0;
+		for(uint32 b = 0; b < 10; b++)
+			chi2 += (bins[b] - m / 10.) * (bins[b] - m / 10.) / (m / 10.);
+		double uniformity = igamc(9. / 2., chi2 / 2.);
+		bool test_ok = (double)passed / m >= min_prop && (m < 55 || uniformity >= 0.0001);
+		ok = ok && test_ok;
+		printf("%-20s %5u/%-5u %12.6f %s\n", test_names[t], passed, m, uniformity, test_ok ? "ok" : "FAIL");
+	}
+	return ok ? 0 : 1;
+}
+
+//==========================================================================//
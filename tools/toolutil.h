@@ -0,0 +1,45 @@
+/*! \file toolutil.h
+	Общие функции разбора параметров командной строки утилит.
+*/
+
+#ifndef _TOOLUTIL_H_
+#define _TOOLUTIL_H_
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "randomgen.h"
+
+//==========================================================================//
+
+/*! Разбор размера с необязательным суффиксом \b K, \b M или \b G (степени 1024).
+	\param _str - строка с размером.
+	\param _res - результат.
+	\returns \b true, если строка корректна и размер помещается в 64 бита, \b false - иначе.
+*/
+inline bool parseSize(const char *_str, uint64 &_res)
+{
+	char *end = NULL;
+	errno = 0;
+	unsigned long long n = strtoull(_str, &end, 10);
+	if(errno || end == _str)
+		return false;
+	uint32 shift = 0;
+	switch(*end)
+	{
+	case 'K': case 'k': shift = 10; break;
+	case 'M': case 'm': shift = 20; break;
+	case 'G': case 'g': shift = 30; break;
+	default: break;
+	}
+	if(shift)
+		end++;
+	if(*end || n > (~0ULL >> shift))
+		return false;
+	_res = n << shift;
+	return true;
+}
+
+//==========================================================================//
+
+#endif
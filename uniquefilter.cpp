@@ -0,0 +1,202 @@
+
+#include <string.h>
+
+#include "uniquefilter.h"
+
+/*! \class UniqueFilter
+	Фильтр для массовой генерации кодов без повторов. Для каждой добавляемой строки вычисляется
+	64-битный хэш. Сначала проверяется блочный фильтр Блума: все биты элемента лежат в одном
+	512-битном блоке (одна строка кэша), поэтому проверка требует одного обращения к памяти.
+	Если фильтр Блума сообщает, что строки не было, она заведомо новая и её отпечаток просто
+	записывается в таблицу. Только при срабатывании фильтра Блума (1-2% строк) выполняется
+	поиск в наборе 32-битных отпечатков (хэш-таблица с открытой адресацией).
+	\par
+	Набор хранит не строки, а отпечатки, и при поиске сравниваются только они, поэтому проверка
+	вероятностная: новая строка признаётся повторной, если фильтр Блума сработал и в цепочке
+	линейного пробирования нашёлся такой же отпечаток чужой строки. Оценка этой вероятности
+	приведена в описании класса в uniquefilter.h. Для генерации уникальных кодов это безопасно:
+	такой код просто отбрасывается и генерируется заново, повторы же не пропускаются никогда.
+	Память - от 6 до 12 байтов на элемент (размер таблицы - степень двойки).
+	\par Пример:
+	\code
+	UniqueFilter uf(10000000);
+	PasswordGen pg;
+	std::vector<char> codes(10000000 * 10);
+	pg.nextUniquePasswords(&codes[0], 10000000, 10, 10, uf);
+	\endcode
+*/
+
+//==========================================================================//
+
+/*! Перемешивание битов 64-битного числа (финализатор MurmurHash3).
+*/
+static inline uint64 mix(uint64 _x)
+{
+	_x ^= _x >> 33;
+	_x *= 0xff51afd7ed558ccdULL;
+	_x ^= _x >> 33;
+	_x *= 0xc4ceb9fe1a85ec53ULL;
+	_x ^= _x >> 33;
+	return _x;
+}
+
+//==========================================================================//
+
+/*! Создаёт пустой фильтр, рассчитанный на \e _capacity строк. Таблица отпечатков заполняется
+	не более чем на 3/4, фильтр Блума имеет \e bloomBitsPerItem битов на строку.
+	\param _capacity - максимальное количество строк.
+*/
+UniqueFilter::UniqueFilter(uint64 _capacity) : count(0), limit(_capacity ? _capacity : 1), bloom_hits(0)
+{
+	blocks = (limit * bloomBitsPerItem + 511) / 512;
+	bloom.assign(blocks * 8, 0);
+	uint64 table_size = 16;
+	while(table_size * 3 / 4 < limit)
+		table_size <<= 1;
+	table.assign(table_size, 0);
+	table_mask = table_size - 1;
+}
+
+//==========================================================================//
+
+/*! Вычисляет 64-битный хэш строки (FNV-1a по 8 байтов с перемешиванием).
+	\param _data - строка.
+	\param _size - длина строки.
+	\returns Хэш.
+*/
+uint64 UniqueFilter::hash(const char *_data, uint32 _size)
+{
+	uint64 h = 0xcbf29ce484222325ULL ^ _size;
+	uint64 w;
+	for(; _size >= 8; _size -= 8, _data += 8)
+	{
+		memcpy(&w, _data, 8);
+		h = mix(h ^ w);
+	}
+	w = 0;
+	memcpy(&w, _data, _size);
+	return mix(h ^ w ^ ((uint64)_size << 56));
+}
+
+//==========================================================================//
+
+/*! Добавляет строку в фильтр.
+	\param _data - строка.
+	\param _size - длина строки.
+	\returns \b true, если строка новая и добавлена, \b false - если она (возможно) уже была
+	добавлена или фильтр заполнен.
+*/
+bool UniqueFilter::insert(const char *_data, uint32 _size)
+{
+	return insertHash(hash(_data, _size));
+}
+
+//==========================================================================//
+
+/*! Добавляет строку в фильтр по её хэшу <em>hash()</em>. Младшие биты хэша задают ячейку таблицы,
+	старшие 32 бита - отпечаток. Блок фильтра Блума выбирается по младшим 32 битам перемешанного
+	хэша, а биты в блоке - по повторно перемешанному хэшу, чтобы номер блока и положение битов
+	в нём не зависели друг от друга.
+	\param _hash - хэш строки.
+	\returns \b true, если строка новая и добавлена, \b false - если она (возможно) уже была
+	добавлена или фильтр заполнен.
+*/
+bool UniqueFilter::insertHash(uint64 _hash)
+{
+	if(count >= limit)
+		return false;
+	uint64 h2 = mix(_hash ^ 0x9e3779b97f4a7c15ULL);
+	uint64 *block = &bloom[(uint64)(((unsigned __int128)(uint32)h2 * blocks) >> 32) * 8];
+	uint64 bits[8] = {0};
+	uint64 b = mix(h2);
+	for(uint32 i = 0; i < bloomHashes; i++, b >>= 9)
+		bits[(b >> 6) & 7] |= (uint64)1 << (b & 63);
+	bool present = true;
+	for(uint32 i = 0; i < 8; i++)
+	{
+		if((block[i] & bits[i]) != bits[i])
+			present = false;
+		block[i] |= bits[i];
+	}
+
+	uint32 fp = _hash >> 32;
+	if(!fp)
+		fp = 1;
+	uint64 pos = _hash & table_mask;
+	if(present)
+	{
+		bloom_hits++;
+		for(; table[pos]; pos = (pos + 1) & table_mask)
+			if(table[pos] == fp)
+				return false;
+	}
+	else
+		while(table[pos])
+			pos = (pos + 1) & table_mask;
+	table[pos] = fp;
+	count++;
+	return true;
+}
+
+//==========================================================================//
+
+/*! Упреждающая загрузка блока фильтра Блума и ячейки таблицы для хэша \e _hash.
+	Позволяет при пакетной обработке совместить промахи кэша нескольких строк.
+	\param _hash - хэш строки.
+*/
+void UniqueFilter::prefetch(uint64 _hash) const
+{
+	uint64 h2 = mix(_hash ^ 0x9e3779b97f4a7c15ULL);
+	__builtin_prefetch(&bloom[(uint64)(((unsigned __int128)(uint32)h2 * blocks) >> 32) * 8], 1);
+	__builtin_prefetch(&table[_hash & table_mask], 1);
+}
+
+//==========================================================================//
+
+/*! Количество добавленных строк.
+*/
+uint64 UniqueFilter::size() const
+{
+	return count;
+}
+
+//==========================================================================//
+
+/*! Максимальное количество строк.
+*/
+uint64 UniqueFilter::capacity() const
+{
+	return limit;
+}
+
+//==========================================================================//
+
+/*! Занимаемая фильтром память в байтах.
+*/
+uint64 UniqueFilter::memory() const
+{
+	return bloom.size() * sizeof(uint64) + table.size() * sizeof(uint32);
+}
+
+//==========================================================================//
+
+/*! Количество срабатываний фильтра Блума (поисков в наборе отпечатков).
+*/
+uint64 UniqueFilter::bloomHits() const
+{
+	return bloom_hits;
+}
+
+//==========================================================================//
+
+/*! Удаляет все строки, сохраняя размеры фильтра.
+*/
+void UniqueFilter::clear()
+{
+	memset(&bloom[0], 0, bloom.size() * sizeof(uint64));
+	memset(&table[0], 0, table.size() * sizeof(uint32));
+	count = 0;
+	bloom_hits = 0;
+}
+
+//==========================================================================//
@@ -0,0 +1,53 @@
+
+#ifndef _UNIQUEFILTER_H_
+#define _UNIQUEFILTER_H_
+
+#include <vector>
+
+#include "randomgen.h"
+
+//==========================================================================//
+
+//! Класс фильтра повторяющихся строк для массовой генерации уникальных кодов.
+/*! Таблица фильтра - набор 32-битных отпечатков, а не строк, поэтому повторы не пропускаются
+	никогда, но новая строка изредка признаётся повторной. Для этого должен сработать фильтр Блума
+	(при полном заполнении с вероятностью \f$ p_B \approx 2.3\% \f$ для 8 битов и 6 хэшей на элемент)
+	и в цепочке пробирования должен найтись такой же отпечаток. При заполнении таблицы не более
+	чем на \f$ \alpha = 3/4 \f$ средняя длина цепочки не превышает
+	\f$ L = (1 + 1/(1 - \alpha)^2) / 2 = 8.5 \f$, и вероятность ложного отказа на одну строку
+	не превышает \f$ p_B \cdot L / 2^{32} \approx 5 \cdot 10^{-11} \f$, то есть около
+	\f$ 5 \cdot 10^{-11} n \f$ лишних отказов на \f$ n \f$ строк.
+*/
+class UniqueFilter
+{
+public:
+	static const uint32 bloomBitsPerItem = 8;		//!< Битов фильтра Блума на элемент.
+	static const uint32 bloomHashes = 6;			//!< Количество битов, устанавливаемых в блоке на элемент.
+
+private:
+	std::vector<uint64> bloom;						//!< Блочный фильтр Блума (блоки по 512 битов).
+	uint64 blocks;									//!< Количество блоков фильтра.
+	std::vector<uint32> table;						//!< Таблица отпечатков с открытой адресацией (\b 0 - пусто).
+	uint64 table_mask;								//!< Маска номера ячейки таблицы.
+	uint64 count;									//!< Количество добавленных элементов.
+	uint64 limit;									//!< Максимальное количество элементов.
+	uint64 bloom_hits;								//!< Количество срабатываний фильтра Блума.
+
+public:
+	explicit UniqueFilter(uint64 _capacity);		//!< Конструктор.
+
+	static uint64 hash(const char *_data, uint32 _size);	//!< Хэш строки.
+	bool insert(const char *_data, uint32 _size);	//!< Добавление строки.
+	bool insertHash(uint64 _hash);					//!< Добавление строки по её хэшу.
+	void prefetch(uint64 _hash) const;				//!< Упреждающая загрузка данных для \e insertHash().
+
+	uint64 size() const;							//!< Количество добавленных строк.
+	uint64 capacity() const;						//!< Максимальное количество строк.
+	uint64 memory() const;							//!< Занимаемая память в байтах.
+	uint64 bloomHits() const;						//!< Количество срабатываний фильтра Блума.
+	void clear();									//!< Удаление всех строк.
+};
+
+//==========================================================================//
+
+#endif